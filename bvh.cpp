@@ -0,0 +1,556 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+// Box
+
+BvhBox::BvhBox() {
+    for (int k = 0; k < 3; ++k) {
+        this->min[k] = FLT_MAX;
+        this->max[k] = -FLT_MAX;
+    }
+}
+
+BvhBox::BvhBox(const float center[3], const float extent[3]) {
+    for (int k = 0; k < 3; ++k) {
+        this->min[k] = center[k] - extent[k];
+        this->max[k] = center[k] + extent[k];
+    }
+}
+
+float BvhBox::area() const {
+    if (this->empty()) {
+        return 0.f;
+    }
+    float dx = this->max[0] - this->min[0];
+    float dy = this->max[1] - this->min[1];
+    float dz = this->max[2] - this->min[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+void BvhBox::grow(const BvhBox &other) {
+    for (int k = 0; k < 3; ++k) {
+        this->min[k] = std::min(this->min[k], other.min[k]);
+        this->max[k] = std::max(this->max[k], other.max[k]);
+    }
+}
+
+bool BvhBox::overlaps(const BvhBox &other) const {
+    for (int k = 0; k < 3; ++k) {
+        if (this->min[k] > other.max[k] || this->max[k] < other.min[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static float centroid(const BvhBox &box, int axis) {
+    return (box.min[axis] + box.max[axis]) * 0.5f;
+}
+
+// Node helpers
+
+BvhBox Bvh::box(int node) const {
+    BvhBox b;
+    for (int k = 0; k < 3; ++k) {
+        b.min[k] = this->nodes[node].min[k];
+        b.max[k] = this->nodes[node].max[k];
+    }
+    return b;
+}
+
+void Bvh::setBox(int node, const BvhBox &b) {
+    for (int k = 0; k < 3; ++k) {
+        this->nodes[node].min[k] = b.min[k];
+        this->nodes[node].max[k] = b.max[k];
+    }
+}
+
+int Bvh::allocSlots() {
+    if (!this->freeSlots.empty()) {
+        int slot = this->freeSlots.back();
+        this->freeSlots.pop_back();
+        return slot;
+    }
+    int slot = this->items.size();
+    this->items.resize(slot + LEAF_SIZE);
+    return slot;
+}
+
+void Bvh::setLeaf(int node, const unsigned *objects, int count) {
+    int slot = this->allocSlots();
+    for (int i = 0; i < count; ++i) {
+        this->items[slot + i] = objects[i];
+        this->leafOf[objects[i]] = node;
+    }
+    this->nodes[node].leftFirst = slot;
+    this->nodes[node].count = count;
+    this->refitNode(node);
+}
+
+void Bvh::refitNode(int node) {
+    const BvhNode &n = this->nodes[node];
+    BvhBox b;
+    if (n.leaf()) {
+        for (int i = 0; i < n.count; ++i) {
+            b.grow(this->boxes[this->items[n.leftFirst + i]]);
+        }
+    } else {
+        b = this->box(n.leftFirst);
+        b.grow(this->box(n.leftFirst + 1));
+    }
+    this->setBox(node, b);
+}
+
+void Bvh::refitUp(int node) {
+    for (; node >= 0; node = this->parents[node]) {
+        this->refitNode(node);
+    }
+}
+
+void Bvh::refit() {
+    // Children always follow their parents
+    for (int node = (int)this->nodes.size() - 1; node >= 0; --node) {
+        this->refitNode(node);
+    }
+}
+
+// Build
+
+void Bvh::build(const ObjectBounds &bounds) {
+    size_t n = bounds.size();
+
+    this->nodes.clear();
+    this->parents.clear();
+    this->items.clear();
+    this->freeSlots.clear();
+    this->boxes.resize(n);
+    this->leafOf.assign(n, -1);
+
+    for (size_t i = 0; i < n; ++i) {
+        float c[3] = { bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] };
+        float e[3] = { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] };
+        this->boxes[i] = BvhBox(c, e);
+    }
+
+    if (n == 0) {
+        return;
+    }
+
+    vector<unsigned> order(n);
+    iota(order.begin(), order.end(), 0);
+
+    this->nodes.reserve(2 * n / LEAF_SIZE * 2 + 1);
+    this->parents.reserve(this->nodes.capacity());
+    this->items.reserve(n * 2);
+
+    this->nodes.push_back(BvhNode());
+    this->parents.push_back(-1);
+    this->buildNode(0, order, 0, n);
+}
+
+void Bvh::buildNode(int node, vector<unsigned> &order, size_t first, size_t count) {
+    if (count <= (size_t)LEAF_SIZE) {
+        this->setLeaf(node, &order[first], count);
+        return;
+    }
+
+    BvhBox centroids;
+    for (size_t i = first; i < first + count; ++i) {
+        const BvhBox &b = this->boxes[order[i]];
+        for (int k = 0; k < 3; ++k) {
+            float c = centroid(b, k);
+            centroids.min[k] = min(centroids.min[k], c);
+            centroids.max[k] = max(centroids.max[k], c);
+        }
+    }
+
+    // Binned SAH over all three axes
+    const int BINS = 16;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = FLT_MAX;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        float lo = centroids.min[axis];
+        float hi = centroids.max[axis];
+        if (hi <= lo) {
+            continue;
+        }
+        float scale = BINS / (hi - lo);
+
+        BvhBox binBoxes[BINS];
+        size_t binCounts[BINS] = {};
+        for (size_t i = first; i < first + count; ++i) {
+            const BvhBox &b = this->boxes[order[i]];
+            int bin = min(BINS - 1, (int)((centroid(b, axis) - lo) * scale));
+            binBoxes[bin].grow(b);
+            ++binCounts[bin];
+        }
+
+        // Sweep from the right, then from the left
+        float rightArea[BINS];
+        size_t rightCount[BINS];
+        BvhBox acc;
+        size_t accCount = 0;
+        for (int bin = BINS - 1; bin > 0; --bin) {
+            acc.grow(binBoxes[bin]);
+            accCount += binCounts[bin];
+            rightArea[bin] = acc.area();
+            rightCount[bin] = accCount;
+        }
+
+        acc = BvhBox();
+        accCount = 0;
+        for (int split = 1; split < BINS; ++split) {
+            acc.grow(binBoxes[split - 1]);
+            accCount += binCounts[split - 1];
+            float cost = acc.area() * accCount + rightArea[split] * rightCount[split];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    size_t mid = first;
+    if (bestAxis >= 0) {
+        float lo = centroids.min[bestAxis];
+        float scale = BINS / (centroids.max[bestAxis] - lo);
+        auto it = partition(order.begin() + first, order.begin() + first + count, [&](unsigned object) {
+            return min(BINS - 1, (int)((centroid(this->boxes[object], bestAxis) - lo) * scale)) < bestSplit;
+        });
+        mid = it - order.begin();
+    }
+    if (mid == first || mid == first + count) {
+        // All centroids coincide: split in half
+        mid = first + count / 2;
+    }
+
+    int left = this->nodes.size();
+    this->nodes.push_back(BvhNode());
+    this->nodes.push_back(BvhNode());
+    this->parents.push_back(node);
+    this->parents.push_back(node);
+    this->nodes[node].leftFirst = left;
+    this->nodes[node].count = -1;
+
+    this->buildNode(left, order, first, mid - first);
+    this->buildNode(left + 1, order, mid, first + count - mid);
+    this->refitNode(node);
+}
+
+// Dynamic updates
+
+void Bvh::update(unsigned object, const float center[3], const float extent[3]) {
+    this->boxes[object] = BvhBox(center, extent);
+}
+
+void Bvh::insert(unsigned object, const float center[3], const float extent[3]) {
+    if (object >= this->boxes.size()) {
+        this->boxes.resize(object + 1);
+        this->leafOf.resize(object + 1, -1);
+    }
+    if (this->leafOf[object] >= 0) {
+        this->remove(object);
+    }
+
+    BvhBox b(center, extent);
+    this->boxes[object] = b;
+
+    if (this->nodes.empty()) {
+        this->nodes.push_back(BvhNode());
+        this->parents.push_back(-1);
+        this->setLeaf(0, &object, 1);
+        return;
+    }
+
+    // Descend into the child whose surface area grows the least
+    int node = 0;
+    while (!this->nodes[node].leaf()) {
+        BvhBox grown = this->box(node);
+        grown.grow(b);
+        this->setBox(node, grown);
+
+        int left = this->nodes[node].leftFirst;
+        float cost[2];
+        for (int i = 0; i < 2; ++i) {
+            BvhBox child = this->box(left + i);
+            float before = child.area();
+            child.grow(b);
+            cost[i] = child.area() - before;
+        }
+        node = cost[0] <= cost[1] ? left : left + 1;
+    }
+
+    BvhNode &leaf = this->nodes[node];
+    if (leaf.count < LEAF_SIZE) {
+        this->items[leaf.leftFirst + leaf.count++] = object;
+        this->leafOf[object] = node;
+        this->refitNode(node);
+        return;
+    }
+
+    // Full leaf: split it into two along the longest centroid axis
+    unsigned objects[LEAF_SIZE + 1];
+    copy(&this->items[leaf.leftFirst], &this->items[leaf.leftFirst] + LEAF_SIZE, objects);
+    objects[LEAF_SIZE] = object;
+    this->freeSlots.push_back(leaf.leftFirst);
+
+    BvhBox centroids;
+    for (unsigned o : objects) {
+        for (int k = 0; k < 3; ++k) {
+            float c = centroid(this->boxes[o], k);
+            centroids.min[k] = min(centroids.min[k], c);
+            centroids.max[k] = max(centroids.max[k], c);
+        }
+    }
+    int axis = 0;
+    for (int k = 1; k < 3; ++k) {
+        if (centroids.max[k] - centroids.min[k] > centroids.max[axis] - centroids.min[axis]) {
+            axis = k;
+        }
+    }
+    sort(objects, objects + LEAF_SIZE + 1, [&](unsigned a, unsigned b) {
+        return centroid(this->boxes[a], axis) < centroid(this->boxes[b], axis);
+    });
+
+    int left = this->nodes.size();
+    this->nodes.push_back(BvhNode());
+    this->nodes.push_back(BvhNode());
+    this->parents.push_back(node);
+    this->parents.push_back(node);
+    this->nodes[node].leftFirst = left;
+    this->nodes[node].count = -1;
+
+    int half = (LEAF_SIZE + 1) / 2;
+    this->setLeaf(left, objects, half);
+    this->setLeaf(left + 1, objects + half, LEAF_SIZE + 1 - half);
+    this->refitNode(node);
+}
+
+void Bvh::remove(unsigned object) {
+    if (object >= this->leafOf.size() || this->leafOf[object] < 0) {
+        return;
+    }
+
+    int node = this->leafOf[object];
+    BvhNode &leaf = this->nodes[node];
+    unsigned *slots = &this->items[leaf.leftFirst];
+    for (int i = 0; i < leaf.count; ++i) {
+        if (slots[i] == object) {
+            slots[i] = slots[--leaf.count];
+            break;
+        }
+    }
+    this->leafOf[object] = -1;
+
+    // Empty leaves stay in the tree with an empty box until the next build
+    this->refitUp(node);
+}
+
+// Queries
+
+// Tests box against the planes in mask. Returns -1 if the box is outside,
+// otherwise mask without planes the box is completely inside of.
+static int classify(const Frustum &frustum, const float *min, const float *max, int mask) {
+    float c[3], e[3];
+    for (int k = 0; k < 3; ++k) {
+        c[k] = (min[k] + max[k]) * 0.5f;
+        e[k] = (max[k] - min[k]) * 0.5f;
+    }
+
+    for (int p = 0; p < 6; ++p) {
+        if (!(mask & (1 << p))) {
+            continue;
+        }
+        const float *plane = frustum.planes[p];
+        float d = plane[0] * c[0] + plane[1] * c[1] + plane[2] * c[2] + plane[3];
+        float r = fabsf(plane[0]) * e[0] + fabsf(plane[1]) * e[1] + fabsf(plane[2]) * e[2];
+        if (d + r < 0.f) {
+            return -1;
+        }
+        if (d - r >= 0.f) {
+            mask &= ~(1 << p);
+        }
+    }
+    return mask;
+}
+
+size_t Bvh::collect(int root, unsigned *out) const {
+    size_t n = 0;
+    int stack[64];
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        const BvhNode &node = this->nodes[stack[--top]];
+        if (node.leaf()) {
+            for (int i = 0; i < node.count; ++i) {
+                out[n++] = this->items[node.leftFirst + i];
+            }
+        } else if (top + 2 <= 64) {
+            stack[top++] = node.leftFirst + 1;
+            stack[top++] = node.leftFirst;
+        } else {
+            n += this->collect(node.leftFirst, out + n);
+            n += this->collect(node.leftFirst + 1, out + n);
+        }
+    }
+    return n;
+}
+
+size_t Bvh::cull(const Frustum &frustum, unsigned *visible) const {
+    if (this->nodes.empty()) {
+        return 0;
+    }
+
+    size_t n = 0;
+    vector<pair<int, int>> stack;
+    stack.reserve(64);
+    stack.push_back(make_pair(0, 0x3f));
+
+    while (!stack.empty()) {
+        int index = stack.back().first;
+        int mask = stack.back().second;
+        stack.pop_back();
+
+        const BvhNode &node = this->nodes[index];
+        if (node.min[0] > node.max[0]) {
+            continue;
+        }
+
+        mask = classify(frustum, node.min, node.max, mask);
+        if (mask < 0) {
+            continue;
+        }
+        if (mask == 0) {
+            // Completely inside
+            n += this->collect(index, visible + n);
+            continue;
+        }
+
+        if (node.leaf()) {
+            for (int i = 0; i < node.count; ++i) {
+                unsigned object = this->items[node.leftFirst + i];
+                const BvhBox &b = this->boxes[object];
+                if (classify(frustum, b.min, b.max, mask) >= 0) {
+                    visible[n++] = object;
+                }
+            }
+        } else {
+            stack.push_back(make_pair(node.leftFirst + 1, mask));
+            stack.push_back(make_pair(node.leftFirst, mask));
+        }
+    }
+    return n;
+}
+
+// Slab test. Returns entry distance or FLT_MAX on miss.
+static float intersect(const float *min, const float *max,
+        const float origin[3], const float invDir[3], float limit) {
+    float tmin = 0.f;
+    float tmax = limit;
+    for (int k = 0; k < 3; ++k) {
+        float t1 = (min[k] - origin[k]) * invDir[k];
+        float t2 = (max[k] - origin[k]) * invDir[k];
+        tmin = std::max(tmin, std::min(t1, t2));
+        tmax = std::min(tmax, std::max(t1, t2));
+    }
+    return tmin <= tmax ? tmin : FLT_MAX;
+}
+
+int Bvh::raycast(const float origin[3], const float dir[3], float *distance) const {
+    int best = -1;
+    float bestT = FLT_MAX;
+    if (this->nodes.empty()) {
+        return best;
+    }
+
+    float invDir[3];
+    for (int k = 0; k < 3; ++k) {
+        invDir[k] = 1.f / dir[k];
+    }
+
+    vector<pair<int, float>> stack;
+    stack.reserve(64);
+    stack.push_back(make_pair(0, intersect(this->nodes[0].min, this->nodes[0].max, origin, invDir, bestT)));
+
+    while (!stack.empty()) {
+        int index = stack.back().first;
+        float t = stack.back().second;
+        stack.pop_back();
+
+        const BvhNode &node = this->nodes[index];
+        if (t >= bestT || node.min[0] > node.max[0]) {
+            continue;
+        }
+
+        if (node.leaf()) {
+            for (int i = 0; i < node.count; ++i) {
+                unsigned object = this->items[node.leftFirst + i];
+                const BvhBox &b = this->boxes[object];
+                float tObject = intersect(b.min, b.max, origin, invDir, bestT);
+                if (tObject < bestT) {
+                    bestT = tObject;
+                    best = object;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        int left = node.leftFirst;
+        float tLeft  = intersect(this->nodes[left].min,     this->nodes[left].max,     origin, invDir, bestT);
+        float tRight = intersect(this->nodes[left + 1].min, this->nodes[left + 1].max, origin, invDir, bestT);
+        if (tLeft <= tRight) {
+            if (tRight < bestT) stack.push_back(make_pair(left + 1, tRight));
+            if (tLeft  < bestT) stack.push_back(make_pair(left,     tLeft));
+        } else {
+            if (tLeft  < bestT) stack.push_back(make_pair(left,     tLeft));
+            if (tRight < bestT) stack.push_back(make_pair(left + 1, tRight));
+        }
+    }
+
+    if (distance) {
+        *distance = bestT;
+    }
+    return best;
+}
+
+void Bvh::query(const BvhBox &b, vector<unsigned> &result) const {
+    if (this->nodes.empty()) {
+        return;
+    }
+
+    vector<int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+
+        const BvhNode &node = this->nodes[index];
+        if (!this->box(index).overlaps(b)) {
+            continue;
+        }
+
+        if (node.leaf()) {
+            for (int i = 0; i < node.count; ++i) {
+                unsigned object = this->items[node.leftFirst + i];
+                if (this->boxes[object].overlaps(b)) {
+                    result.push_back(object);
+                }
+            }
+        } else {
+            stack.push_back(node.leftFirst + 1);
+            stack.push_back(node.leftFirst);
+        }
+    }
+}
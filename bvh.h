@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "culling.h"
+
+struct BvhBox {
+    float min[3];
+    float max[3];
+
+    BvhBox();
+    BvhBox(const float center[3], const float extent[3]);
+
+    bool empty() const { return this->min[0] > this->max[0]; }
+    float area() const;
+    void grow(const BvhBox &other);
+    bool overlaps(const BvhBox &other) const;
+};
+
+// 32 bytes, two nodes per cache line. Children of an interior node are
+// stored next to each other, always after their parent.
+struct BvhNode {
+    float min[3];
+    int leftFirst;  // Interior: left child (right is left + 1). Leaf: first slot in items
+    float max[3];
+    int count;      // Leaf: number of items. Interior: -1
+
+    bool leaf() const { return this->count >= 0; }
+};
+
+// Bounding volume hierarchy over object boxes. Built with binned SAH,
+// then kept up to date by refitting and incremental insert/remove.
+struct Bvh {
+    // Slots reserved per leaf; leaves hold at most this many objects
+    static const int LEAF_SIZE = 4;
+
+    std::vector<BvhNode> nodes;
+    std::vector<int> parents;
+
+    std::vector<unsigned> items;  // LEAF_SIZE slots per leaf
+    std::vector<int> freeSlots;   // Slot blocks of removed leaves
+
+    std::vector<BvhBox> boxes;    // Per object
+    std::vector<int> leafOf;      // Per object, -1 if not in the tree
+
+    void build(const ObjectBounds &bounds);
+
+    // Changes the box of an object; bounds of the tree are stale until refit()
+    void update(unsigned object, const float center[3], const float extent[3]);
+    void refit();
+
+    void insert(unsigned object, const float center[3], const float extent[3]);
+    void remove(unsigned object);
+
+    // Writes indices of objects whose boxes intersect the frustum to visible.
+    // Returns their number.
+    size_t cull(const Frustum &frustum, unsigned *visible) const;
+
+    // Nearest object whose box is hit by the ray, -1 if none.
+    // Distance is measured in units of dir.
+    int raycast(const float origin[3], const float dir[3], float *distance = NULL) const;
+
+    // Appends objects whose boxes overlap box to result
+    void query(const BvhBox &box, std::vector<unsigned> &result) const;
+
+    // Internal
+    void buildNode(int node, std::vector<unsigned> &order, size_t first, size_t count);
+    int allocSlots();
+    void setLeaf(int node, const unsigned *objects, int count);
+    void setBox(int node, const BvhBox &box);
+    BvhBox box(int node) const;
+    void refitNode(int node);
+    void refitUp(int node);
+    size_t collect(int node, unsigned *out) const;
+};
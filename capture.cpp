@@ -0,0 +1,386 @@
+#include "capture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "png.h"
+
+using namespace std;
+
+const int FrameCapture::SLOTS;
+
+// Longest clear() waits for a read in flight
+static const GLuint64 CLEAR_TIMEOUT_NS = 1000000000;
+
+const char *captureFormatName(CaptureFormat format) {
+    switch (format) {
+        case CAPTURE_PNG: return "png";
+        case CAPTURE_Y4M: return "y4m";
+    }
+    return "unknown";
+}
+
+FrameCapture::FrameCapture(CaptureFormat format, const char *path, int fps)
+        : format(format), path(path), fps(fps), next(0), recording(false), recordings(0), nextNumber(0), frames(0),
+          dropped(0), quit(false), current(0), written(0), video(NULL), videoWidth(0), videoHeight(0) {
+    for (Slot &slot : this->slots) {
+        slot.buffer = BufferHandle::create();
+        slot.capacity = 0;
+        slot.fence = NULL;
+        slot.state = SLOT_FREE;
+        slot.pixels = NULL;
+    }
+    this->worker = thread([this]() { this->workerLoop(); });
+}
+
+FrameCapture::~FrameCapture() {
+    {
+        lock_guard<mutex> lock(this->queueMutex);
+        this->quit = true;
+    }
+    this->wake.notify_one();
+    this->worker.join();
+
+    if (this->video) {
+        fclose(this->video);
+    }
+}
+
+unsigned FrameCapture::currentNumber() const {
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - this->startTime;
+    return unsigned(elapsed.count() * this->fps);
+}
+
+void FrameCapture::start() {
+    if (this->recording) {
+        return;
+    }
+    this->recording = true;
+    ++this->recordings;
+    this->startTime = chrono::steady_clock::now();
+    this->nextNumber = 0;
+    this->frames = 0;
+    this->dropped = 0;
+}
+
+void FrameCapture::stop() {
+    if (!this->recording) {
+        return;
+    }
+    this->recording = false;
+    unsigned frameCount = max(this->currentNumber() + 1, this->nextNumber);
+
+    // The end follows the last read, which may still be in flight
+    Slot &newest = this->slots[(this->next + SLOTS - 1) % SLOTS];
+    if (newest.state == SLOT_READING && newest.recording == this->recordings) {
+        newest.last = true;
+        newest.frameCount = frameCount;
+        return;
+    }
+    {
+        lock_guard<mutex> lock(this->queueMutex);
+        this->queue.push_back({ -1, this->recordings, frameCount });
+    }
+    this->wake.notify_one();
+}
+
+void FrameCapture::capture(int width, int height) {
+    if (!this->recording) {
+        return;
+    }
+
+    // Already have this time slot's frame
+    unsigned number = this->currentNumber();
+    if (number < this->nextNumber) {
+        return;
+    }
+    this->nextNumber = number + 1;
+
+    // GPU or encoder behind: the slot gets the previous frame again
+    Slot &slot = this->slots[this->next];
+    if (slot.state != SLOT_FREE) {
+        ++this->dropped;
+        return;
+    }
+
+    size_t size = size_t(width) * height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = SLOT_READING;
+    slot.width = width;
+    slot.height = height;
+    slot.number = number;
+    slot.recording = this->recordings;
+    slot.last = false;
+    ++this->frames;
+    this->next = (this->next + 1) % SLOTS;
+}
+
+void FrameCapture::map(int index) {
+    Slot &slot = this->slots[index];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    slot.pixels = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size_t(slot.width) * slot.height * 4,
+            GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteSync(slot.fence);
+    slot.fence = NULL;
+    slot.state = slot.pixels ? SLOT_MAPPED : SLOT_FREE;
+
+    {
+        lock_guard<mutex> lock(this->queueMutex);
+        if (slot.pixels) {
+            this->queue.push_back({ index, slot.recording, slot.number });
+        }
+        if (slot.last) {
+            this->queue.push_back({ -1, slot.recording, slot.frameCount });
+        }
+    }
+    this->wake.notify_one();
+}
+
+void FrameCapture::poll() {
+    // Buffers the encoder is done with
+    vector<int> done;
+    {
+        lock_guard<mutex> lock(this->queueMutex);
+        done.swap(this->finished);
+    }
+    for (int index : done) {
+        Slot &slot = this->slots[index];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.pixels = NULL;
+        slot.state = SLOT_FREE;
+    }
+
+    // Reads finish in order, oldest first
+    for (int k = 0; k < SLOTS; ++k) {
+        int index = (this->next + k) % SLOTS;
+        Slot &slot = this->slots[index];
+        if (slot.state != SLOT_READING) {
+            continue;
+        }
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        this->map(index);
+    }
+}
+
+void FrameCapture::clear() {
+    this->stop();
+
+    for (int k = 0; k < SLOTS; ++k) {
+        int index = (this->next + k) % SLOTS;
+        Slot &slot = this->slots[index];
+        if (slot.state != SLOT_READING) {
+            continue;
+        }
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, CLEAR_TIMEOUT_NS);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            this->map(index);
+            continue;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = NULL;
+        slot.state = SLOT_FREE;
+        if (slot.last) {
+            lock_guard<mutex> lock(this->queueMutex);
+            this->queue.push_back({ -1, slot.recording, slot.frameCount });
+        }
+    }
+    this->wake.notify_one();
+
+    // Buffers can't stay mapped past the context
+    size_t mapped = 0;
+    for (const Slot &slot : this->slots) {
+        mapped += slot.state == SLOT_MAPPED;
+    }
+    {
+        unique_lock<mutex> lock(this->queueMutex);
+        this->encoded.wait(lock, [&]() { return this->finished.size() == mapped; });
+    }
+    this->poll();
+}
+
+void FrameCapture::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            unique_lock<mutex> lock(this->queueMutex);
+            this->wake.wait(lock, [this]() { return this->quit || !this->queue.empty(); });
+            if (this->queue.empty()) {
+                return;
+            }
+            job = this->queue.front();
+            this->queue.pop_front();
+        }
+        this->encode(job);
+    }
+}
+
+// BT.601 limited range
+static inline uint8_t lumaOf(int r, int g, int b) {
+    return uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uint8_t blueDifferenceOf(int r, int g, int b) {
+    return uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline uint8_t redDifferenceOf(int r, int g, int b) {
+    return uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// Full resolution luma, then chroma averaged over 2x2 pixels; rows top first
+static void convertToYuv(const uint8_t *rgba, int w, int h, vector<uint8_t> &out) {
+    int cw = (w + 1) / 2;
+    int ch = (h + 1) / 2;
+    out.resize(size_t(w) * h + 2 * size_t(cw) * ch);
+    uint8_t *luma = out.data();
+    uint8_t *cb = luma + size_t(w) * h;
+    uint8_t *cr = cb + size_t(cw) * ch;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t *row = rgba + size_t(h - 1 - y) * w * 4;
+        for (int x = 0; x < w; ++x) {
+            luma[size_t(y) * w + x] = lumaOf(row[x * 4], row[x * 4 + 1], row[x * 4 + 2]);
+        }
+    }
+    for (int y = 0; y < ch; ++y) {
+        const uint8_t *row0 = rgba + size_t(h - 1 - 2 * y) * w * 4;
+        const uint8_t *row1 = rgba + size_t(max(h - 2 - 2 * y, 0)) * w * 4;
+        for (int x = 0; x < cw; ++x) {
+            int x0 = 2 * x * 4;
+            int x1 = min(2 * x + 1, w - 1) * 4;
+            int r = (row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2;
+            int g = (row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1] + 2) >> 2;
+            int b = (row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2] + 2) >> 2;
+            cb[size_t(y) * cw + x] = blueDifferenceOf(r, g, b);
+            cr[size_t(y) * cw + x] = redDifferenceOf(r, g, b);
+        }
+    }
+}
+
+void FrameCapture::encode(const Job &job) {
+    if (job.slot < 0) {
+        if (job.recording == this->current) {
+            this->finish(job.number);
+        }
+        return;
+    }
+
+    if (job.recording != this->current) {
+        this->finish(this->written);
+        this->current = job.recording;
+        this->written = 0;
+    }
+
+    // Read straight from the mapped buffer, then hand it back before the slow part
+    const Slot &slot = this->slots[job.slot];
+    int w = slot.width;
+    int h = slot.height;
+    bool fresh = true;
+    if (this->format == CAPTURE_PNG) {
+        this->rgb.resize(size_t(w) * h * 3);
+        for (size_t i = 0, n = size_t(w) * h; i < n; ++i) {
+            memcpy(&this->rgb[i * 3], &slot.pixels[i * 4], 3);
+        }
+    } else {
+        // A video keeps the size of its first frame; frames of another size repeat the one before
+        if (this->written == 0 && !this->video) {
+            char name[32];
+            snprintf(name, sizeof(name), "_%u.y4m", job.recording);
+            string videoPath = this->path + name;
+            this->video = fopen(videoPath.c_str(), "wb");
+            if (!this->video) {
+                cerr << "ERROR::CAPTURE::CANNOT_OPEN " << videoPath << endl;
+            } else {
+                fprintf(this->video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, this->fps);
+            }
+            this->videoWidth = w;
+            this->videoHeight = h;
+        }
+        fresh = w == this->videoWidth && h == this->videoHeight;
+        if (fresh) {
+            convertToYuv(slot.pixels, w, h, this->frame);
+        }
+    }
+    {
+        lock_guard<mutex> lock(this->queueMutex);
+        this->finished.push_back(job.slot);
+    }
+    this->encoded.notify_one();
+
+    if (!fresh) {
+        this->repeat(this->lastFrame, job.number + 1);
+        return;
+    }
+    if (this->format == CAPTURE_PNG) {
+        encodePng(this->rgb.data(), w, h, true, this->frame);
+    }
+
+    // Slots missed since the last frame repeat it; missed ones at the start take this one
+    this->repeat(this->written == 0 ? this->frame : this->lastFrame, job.number);
+    this->emit(this->frame, job.number);
+    this->written = job.number + 1;
+    this->frame.swap(this->lastFrame);
+}
+
+void FrameCapture::emit(const vector<uint8_t> &bytes, unsigned number) {
+    if (this->format == CAPTURE_Y4M) {
+        if (this->video) {
+            fputs("FRAME\n", this->video);
+            fwrite(bytes.data(), 1, bytes.size(), this->video);
+        }
+        return;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "_%u_%06u.png", this->current, number);
+    string filePath = this->path + name;
+    FILE *file = fopen(filePath.c_str(), "wb");
+    if (!file) {
+        cerr << "ERROR::CAPTURE::CANNOT_OPEN " << filePath << endl;
+        return;
+    }
+    if (fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+        cerr << "ERROR::CAPTURE::CANNOT_WRITE " << filePath << endl;
+    }
+    fclose(file);
+}
+
+void FrameCapture::repeat(const vector<uint8_t> &bytes, unsigned until) {
+    if (bytes.empty()) {
+        return;
+    }
+    for (; this->written < until; ++this->written) {
+        this->emit(bytes, this->written);
+    }
+}
+
+void FrameCapture::finish(unsigned frameCount) {
+    if (this->current == 0) {
+        return;
+    }
+    this->repeat(this->lastFrame, frameCount);
+    if (this->video) {
+        fclose(this->video);
+        this->video = NULL;
+    }
+    this->current = 0;
+    this->written = 0;
+    this->lastFrame.clear();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "context.h"
+#include "glhandle.h"
+
+enum CaptureFormat {
+    CAPTURE_PNG,  // One file per frame: <path>_<recording>_<frame>.png
+    CAPTURE_Y4M,  // One raw YUV 4:2:0 video per recording: <path>_<recording>.y4m
+};
+
+const char *captureFormatName(CaptureFormat format);
+
+// Records the back buffer without stalling the frame. glReadPixels goes
+// into a ring of pixel pack buffers and returns at once; a fence tells
+// when a buffer's copy is done, a few frames later, and only then is it
+// mapped. The encoder thread reads the mapped buffer itself, and the main
+// thread unmaps it once the encoder hands it back.
+//
+// Frames are taken at fps by the wall clock, whatever the render rate.
+// Time slots without a frame, because rendering was slower or every
+// buffer was busy, repeat the frame before, so a recording lasts as long
+// as it took.
+struct FrameCapture {
+    static const int SLOTS = 4;
+
+    enum SlotState {
+        SLOT_FREE,
+        SLOT_READING,  // Fence pending
+        SLOT_MAPPED,   // Lent to the encoder
+    };
+
+    struct Slot {
+        BufferHandle buffer;
+        size_t capacity;
+        GLsync fence;
+        SlotState state;
+        const uint8_t *pixels;  // While mapped
+        int width;
+        int height;
+        unsigned number;
+        unsigned recording;
+        bool last;            // Recording stopped after this read
+        unsigned frameCount;  // Length of that recording
+    };
+
+    // Work for the encoder: a mapped slot, or the end of a recording
+    struct Job {
+        int slot;  // -1 for the end
+        unsigned recording;
+        unsigned number;  // Frame index, or the frame count at the end
+    };
+
+    CaptureFormat format;
+    std::string path;
+    int fps;  // Frames per second of recordings
+
+    Slot slots[SLOTS];
+    int next;  // Slot the next capture() uses, also the oldest in flight
+
+    bool recording;
+    unsigned recordings;  // Started so far
+    std::chrono::steady_clock::time_point startTime;
+    unsigned nextNumber;  // Earliest time slot not captured yet
+    unsigned frames;      // Captured in this recording
+    unsigned dropped;     // Time slots missed because every buffer was busy
+
+    // Encoder thread
+    std::thread worker;
+    std::mutex queueMutex;
+    std::condition_variable wake;
+    std::condition_variable encoded;
+    std::deque<Job> queue;
+    std::vector<int> finished;  // Slots the encoder is done reading
+    bool quit;
+
+    // Worker only
+    unsigned current;   // Recording being written, 0 for none
+    unsigned written;   // Frames written of it
+    FILE *video;
+    int videoWidth;
+    int videoHeight;
+    std::vector<uint8_t> rgb;
+    std::vector<uint8_t> frame;      // Encoded newest frame
+    std::vector<uint8_t> lastFrame;  // Encoded frame before it
+
+    FrameCapture(CaptureFormat format, const char *path, int fps);
+    ~FrameCapture();
+
+    void start();
+    void stop();
+
+    // Queues a read of the back buffer, after the frame is drawn and before the swap
+    void capture(int width, int height);
+
+    // Unmaps what the encoder is done with and hands it finished reads; call every frame, also after stop()
+    void poll();
+
+    // Ends the recording and waits for reads & the encoder, while the context is current
+    void clear();
+
+    // Internal
+    unsigned currentNumber() const;
+    void map(int slot);
+    void workerLoop();
+    void encode(const Job &job);
+    void emit(const std::vector<uint8_t> &bytes, unsigned number);
+    void repeat(const std::vector<uint8_t> &bytes, unsigned until);
+    void finish(unsigned frameCount);
+};
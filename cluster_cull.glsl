@@ -0,0 +1,82 @@
+#version 430 core
+
+layout (local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+struct Meshlet {
+    vec4 sphere;  // Center, radius
+    vec4 cone;    // Axis, cutoff
+    uvec4 range;  // First index, index count, vertex count
+};
+
+layout (std430, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout (std430, binding = 1) readonly buffer Models { mat4 models[]; };
+layout (std430, binding = 2) readonly buffer Objects { DrawCommand objects[]; };
+layout (std430, binding = 3) writeonly buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 4) buffer Count { uint commandCount; };
+
+uniform vec4 planes[6];
+uniform vec3 eye;
+uniform uint meshletCount;
+uniform uint firstIndex;
+uniform uint finestFirstIndex;
+uniform uint commandCapacity;
+
+void emit(DrawCommand command) {
+    uint slot = atomicAdd(commandCount, 1u);
+    if (slot < commandCapacity) {
+        commands[slot] = command;
+    }
+}
+
+void main() {
+    uint d = gl_WorkGroupID.y;
+    uint m = gl_GlobalInvocationID.x;
+    if (m >= meshletCount) {
+        return;
+    }
+
+    // Occluded by HiZ
+    DrawCommand object = objects[d];
+    if (object.instanceCount == 0u) {
+        return;
+    }
+
+    // Coarser lods are drawn whole, once
+    if (object.firstIndex != finestFirstIndex) {
+        if (m == 0u) {
+            emit(object);
+        }
+        return;
+    }
+
+    Meshlet meshlet = meshlets[m];
+    mat4 model = models[d];
+    vec3 center = (model * vec4(meshlet.sphere.xyz, 1.0)).xyz;
+    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+    float radius = meshlet.sphere.w * scale;
+
+    for (int p = 0; p < 6; ++p) {
+        if (dot(planes[p].xyz, center) + planes[p].w < -radius) {
+            return;
+        }
+    }
+
+    // Backfacing from everywhere eye can be (models are rigid or uniformly scaled)
+    if (meshlet.cone.w < 1.0) {
+        vec3 axis = normalize(mat3(model) * meshlet.cone.xyz);
+        vec3 view = center - eye;
+        if (dot(view, axis) >= meshlet.cone.w * length(view) + radius) {
+            return;
+        }
+    }
+
+    emit(DrawCommand(meshlet.range.y, 1u, firstIndex + meshlet.range.x, object.baseVertex, object.baseInstance));
+}
@@ -0,0 +1,81 @@
+#include "clustercull.h"
+
+#include <algorithm>
+
+using namespace std;
+
+bool ClusterCuller::supported() {
+    return HiZ::supported() && SDL_GL_ExtensionSupported("GL_ARB_indirect_parameters");
+}
+
+ClusterCuller::ClusterCuller(size_t drawCapacity, size_t commandCapacity)
+        : meshletsBuffer(BufferHandle::create()), modelsBuffer(BufferHandle::create()),
+          commandBuffer(BufferHandle::create()), countBuffer(BufferHandle::create()),
+          meshletCount(0), drawCapacity(drawCapacity), commandCapacity(commandCapacity),
+          firstIndex(0), finestFirstIndex(0) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->modelsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, drawCapacity * 16 * sizeof(float), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commandCapacity * 5 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->countBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    this->cullProgram = new ShaderProgram("cluster_cull.glsl");
+}
+
+ClusterCuller::~ClusterCuller() {
+    delete this->cullProgram;
+}
+
+void ClusterCuller::setMeshlets(const Meshlet *meshlets, size_t count, const MeshLod &finest, GLuint firstIndex) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->meshletsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(Meshlet), meshlets, GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    this->meshletCount = count;
+    this->firstIndex = firstIndex;
+    this->finestFirstIndex = firstIndex + finest.firstIndex;
+}
+
+void ClusterCuller::cull(const HiZ &hiz, const float *models, size_t count, const Frustum &frustum, const float eye[3]) {
+    count = min(count, min(this->drawCapacity, hiz.capacity));
+
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->modelsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * 16 * sizeof(float), models);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->countBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->meshletsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->modelsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, hiz.commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, this->commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, this->countBuffer);
+
+    this->cullProgram->use();
+    this->cullProgram->set4fv("planes", 6, &frustum.planes[0][0]);
+    this->cullProgram->set3f("eye", eye[0], eye[1], eye[2]);
+    this->cullProgram->set1ui("meshletCount", this->meshletCount);
+    this->cullProgram->set1ui("firstIndex", this->firstIndex);
+    this->cullProgram->set1ui("finestFirstIndex", this->finestFirstIndex);
+    this->cullProgram->set1ui("commandCapacity", this->commandCapacity);
+
+    // HiZ's commands were written by a compute shader too
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // One row of groups per draw
+    if (count > 0 && this->meshletCount > 0) {
+        glDispatchCompute((this->meshletCount + 63) / 64, count, 1);
+    }
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void ClusterCuller::draw(GLenum indexType) const {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, this->countBuffer);
+    glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, indexType, 0, 0, this->commandCapacity, 0);
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
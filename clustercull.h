@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+#include "context.h"
+#include "culling.h"
+#include "glhandle.h"
+#include "hiz.h"
+#include "meshlet.h"
+#include "shader.h"
+
+// Meshlet level culling on the GPU, after HiZ object culling (needs OpenGL 4.3
+// and GL_ARB_indirect_parameters).
+//
+// Every meshlet of every object HiZ left visible at the finest lod is
+// tested against the frustum and its normal cone. Survivors are appended
+// as indirect draws of their index range, coarser lods as one draw of the
+// whole range. The number of draws stays on the GPU in countBuffer.
+struct ClusterCuller {
+    ShaderProgram *cullProgram;
+
+    BufferHandle meshletsBuffer;  // Meshlet per meshlet
+    BufferHandle modelsBuffer;    // Model matrix per draw
+    BufferHandle commandBuffer;   // DrawElementsIndirectCommand per surviving meshlet
+    BufferHandle countBuffer;     // Number of commands written
+    size_t meshletCount;
+    size_t drawCapacity;
+    size_t commandCapacity;  // Meshlets beyond it are not drawn
+    GLuint firstIndex;  // Of the mesh in the index buffer
+    GLuint finestFirstIndex;
+
+    static bool supported();
+
+    ClusterCuller(size_t drawCapacity, size_t commandCapacity);
+    ~ClusterCuller();
+
+    // Meshlets of a mesh whose indices start at firstIndex
+    void setMeshlets(const Meshlet *meshlets, size_t count, const MeshLod &finest, GLuint firstIndex = 0);
+
+    // Refines hiz's commands for count draws, draw i with models[i * 16]
+    void cull(const HiZ &hiz, const float *models, size_t count, const Frustum &frustum, const float eye[3]);
+
+    // Draws the commands of the last cull() with the bound VAO
+    void draw(GLenum indexType) const;
+};
@@ -0,0 +1,46 @@
+#version 330 core
+
+// Clustered forward shading: only the lights listed for the fragment's cluster
+
+#include "lighting.glsl"
+
+in vec3 normal;
+in vec3 worldPosition;
+
+uniform samplerBuffer lights;        // Position & radius, color & intensity
+uniform usamplerBuffer lightGrid;    // Offset & count per cluster
+uniform usamplerBuffer lightIndices;
+uniform vec2 viewportSize;
+uniform vec2 depthRange;             // Near & far
+uniform vec3 eye;
+
+out vec4 fragColor;
+
+const ivec3 GRID = ivec3(16, 9, 24);  // LightGrid::TILES_X, TILES_Y, SLICES
+
+const vec3 ALBEDO = vec3(1.0, 0.0, 0.0);
+const float ROUGHNESS = 0.5;
+
+void main() {
+    // Cluster from screen position & linear depth
+    float near = depthRange.x;
+    float far = depthRange.y;
+    float depth = 2.0 * near * far / (far + near - (2.0 * gl_FragCoord.z - 1.0) * (far - near));
+    int slice = clamp(int(log(depth / near) / log(far / near) * float(GRID.z)), 0, GRID.z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / viewportSize * vec2(GRID.xy)), ivec2(0), GRID.xy - 1);
+    uvec2 list = texelFetch(lightGrid, (slice * GRID.y + tile.y) * GRID.x + tile.x).rg;
+
+    vec3 n = normalize(normal);
+    vec3 v = normalize(eye - worldPosition);
+
+    vec3 sun = SUN_COLOR * max(dot(n, SUN_DIRECTION), 0.0) * sunShadow(worldPosition, n);
+    vec3 color = ALBEDO * (AMBIENT + sun);
+    for (uint k = 0u; k < list.y; ++k) {
+        int i = int(texelFetch(lightIndices, int(list.x + k)).r);
+        color += pointLight(worldPosition, n, v, ALBEDO, ROUGHNESS,
+                texelFetch(lights, 2 * i), texelFetch(lights, 2 * i + 1));
+    }
+    color = pow(color, vec3(0.4545));
+
+    fragColor = vec4(color, 1.);
+}
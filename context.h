@@ -0,0 +1,10 @@
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+
+// Window and GL context, created in main()
+extern SDL_Window *win;
+extern SDL_GLContext cont;
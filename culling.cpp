@@ -0,0 +1,168 @@
+#include "culling.h"
+
+#include <cmath>
+#include <immintrin.h>
+
+using namespace std;
+
+// Frustum
+
+Frustum::Frustum(const float *m) {
+    // Rows of the matrix
+    float r[4][4];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            r[i][j] = m[j * 4 + i];
+        }
+    }
+
+    for (int j = 0; j < 4; ++j) {
+        this->planes[LEFT]  [j] = r[3][j] + r[0][j];
+        this->planes[RIGHT] [j] = r[3][j] - r[0][j];
+        this->planes[BOTTOM][j] = r[3][j] + r[1][j];
+        this->planes[TOP]   [j] = r[3][j] - r[1][j];
+        this->planes[NEAR]  [j] = r[3][j] + r[2][j];
+        this->planes[FAR]   [j] = r[3][j] - r[2][j];
+    }
+
+    for (auto &p : this->planes) {
+        float len = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        for (int j = 0; j < 4; ++j) {
+            p[j] /= len;
+        }
+    }
+}
+
+bool Frustum::testSphere(const float c[3], float radius) const {
+    for (auto &p : this->planes) {
+        if (p[0] * c[0] + p[1] * c[1] + p[2] * c[2] + p[3] < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::testBox(const float c[3], const float e[3]) const {
+    for (auto &p : this->planes) {
+        float d = p[0] * c[0] + p[1] * c[1] + p[2] * c[2] + p[3];
+        float r = fabsf(p[0]) * e[0] + fabsf(p[1]) * e[1] + fabsf(p[2]) * e[2];
+        if (d < -r) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bounds
+
+void ObjectBounds::resize(size_t n) {
+    this->centerX.resize(n);
+    this->centerY.resize(n);
+    this->centerZ.resize(n);
+    this->extentX.resize(n);
+    this->extentY.resize(n);
+    this->extentZ.resize(n);
+    this->radius.resize(n);
+}
+
+void ObjectBounds::set(size_t i, const float center[3], const float extent[3], float radius) {
+    this->centerX[i] = center[0];
+    this->centerY[i] = center[1];
+    this->centerZ[i] = center[2];
+    this->extentX[i] = extent[0];
+    this->extentY[i] = extent[1];
+    this->extentZ[i] = extent[2];
+    this->radius[i] = radius;
+}
+
+// Culling
+
+static bool hasAvx() {
+    static bool avx = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") != 0;
+    }();
+    return avx;
+}
+
+static size_t cullScalar(const Frustum &frustum, const ObjectBounds &b,
+        size_t begin, size_t end, unsigned *visible, bool boxes) {
+    size_t n = 0;
+    for (size_t i = begin; i < end; ++i) {
+        float c[3] = { b.centerX[i], b.centerY[i], b.centerZ[i] };
+        float e[3] = { b.extentX[i], b.extentY[i], b.extentZ[i] };
+        if (boxes ? frustum.testBox(c, e) : frustum.testSphere(c, b.radius[i])) {
+            visible[n++] = i;
+        }
+    }
+    return n;
+}
+
+__attribute__((target("avx")))
+static size_t cullAvx(const Frustum &frustum, const ObjectBounds &b,
+        size_t begin, size_t end, unsigned *visible, bool boxes) {
+    __m256 nx[6], ny[6], nz[6], nd[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; ++p) {
+        nx[p] = _mm256_set1_ps(frustum.planes[p][0]);
+        ny[p] = _mm256_set1_ps(frustum.planes[p][1]);
+        nz[p] = _mm256_set1_ps(frustum.planes[p][2]);
+        nd[p] = _mm256_set1_ps(frustum.planes[p][3]);
+        ax[p] = _mm256_set1_ps(fabsf(frustum.planes[p][0]));
+        ay[p] = _mm256_set1_ps(fabsf(frustum.planes[p][1]));
+        az[p] = _mm256_set1_ps(fabsf(frustum.planes[p][2]));
+    }
+
+    size_t n = 0;
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&b.centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&b.centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&b.centerZ[i]);
+
+        __m256 ex = _mm256_setzero_ps(), ey = ex, ez = ex, r = ex;
+        if (boxes) {
+            ex = _mm256_loadu_ps(&b.extentX[i]);
+            ey = _mm256_loadu_ps(&b.extentY[i]);
+            ez = _mm256_loadu_ps(&b.extentZ[i]);
+        } else {
+            r = _mm256_loadu_ps(&b.radius[i]);
+        }
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+                                     _mm256_add_ps(_mm256_mul_ps(nz[p], cz), nd[p]));
+            if (boxes) {
+                r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)),
+                                  _mm256_mul_ps(az[p], ez));
+            }
+            // d >= -r  <=>  d + r >= 0
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            visible[n++] = i + lane;
+            mask &= mask - 1;
+        }
+    }
+
+    return n + cullScalar(frustum, b, i, end, visible + n, boxes);
+}
+
+size_t cullSpheres(const Frustum &frustum, const ObjectBounds &bounds,
+        size_t begin, size_t end, unsigned *visible) {
+    if (hasAvx()) {
+        return cullAvx(frustum, bounds, begin, end, visible, false);
+    }
+    return cullScalar(frustum, bounds, begin, end, visible, false);
+}
+
+size_t cullBoxes(const Frustum &frustum, const ObjectBounds &bounds,
+        size_t begin, size_t end, unsigned *visible) {
+    if (hasAvx()) {
+        return cullAvx(frustum, bounds, begin, end, visible, true);
+    }
+    return cullScalar(frustum, bounds, begin, end, visible, true);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Frustum as six planes (a, b, c, d), normals pointing inside:
+// a point p is inside a plane when a*p.x + b*p.y + c*p.z + d >= 0
+struct Frustum {
+    enum { LEFT, RIGHT, BOTTOM, TOP, NEAR, FAR };
+
+    float planes[6][4];
+
+    // Gribb-Hartmann extraction from a column-major projection * view matrix
+    Frustum(const float *viewProjection);
+    Frustum() {}
+
+    bool testSphere(const float center[3], float radius) const;
+    bool testBox(const float center[3], const float extent[3]) const;
+};
+
+// Per-object world-space bounds in structure-of-arrays layout:
+// an axis-aligned box (center, half extents) and its bounding sphere
+struct ObjectBounds {
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+
+    size_t size() const { return this->radius.size(); }
+    void resize(size_t n);
+
+    void set(size_t i, const float center[3], const float extent[3], float radius);
+};
+
+struct CullStats {
+    size_t tested;
+    size_t visible;
+    size_t occluded;  // Part of culled hidden behind other objects
+
+    CullStats() : tested(0), visible(0), occluded(0) {}
+
+    size_t culled() const { return this->tested - this->visible; }
+};
+
+// Append indices of objects in [begin, end) whose sphere (or box)
+// intersects the frustum to visible. Returns how many were written.
+// Eight objects are tested at a time when AVX is available.
+size_t cullSpheres(const Frustum &frustum, const ObjectBounds &bounds,
+        size_t begin, size_t end, unsigned *visible);
+size_t cullBoxes(const Frustum &frustum, const ObjectBounds &bounds,
+        size_t begin, size_t end, unsigned *visible);
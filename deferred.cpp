@@ -0,0 +1,208 @@
+#include "deferred.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace std;
+
+vector<PointLight> scatterLights(size_t count, const float center[3], const float extent[3], float radius,
+        unsigned seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<float> unit(-1.f, 1.f);
+    uniform_real_distribution<float> hue(0.f, 1.f);
+
+    vector<PointLight> lights(count);
+    for (auto &light : lights) {
+        for (int k = 0; k < 3; ++k) {
+            light.position[k] = center[k] + unit(rng) * extent[k];
+        }
+        light.radius = radius * (1.f + 0.5f * unit(rng));
+
+        // Saturated color from a random hue
+        float h = hue(rng) * 6.f;
+        for (int k = 0; k < 3; ++k) {
+            float d = fabsf(fmodf(h + 4.f - 2.f * k, 6.f) - 3.f);
+            light.color[k] = min(max(d - 1.f, 0.f), 1.f);
+        }
+        light.intensity = 4.f;
+    }
+    return lights;
+}
+
+// Light buffer
+
+LightBuffer::LightBuffer() : buffer(BufferHandle::create()), texture(TextureHandle::create()), count(0) {
+}
+
+void LightBuffer::set(const vector<PointLight> &lights) {
+    glBindBuffer(GL_TEXTURE_BUFFER, this->buffer);
+    glBufferData(GL_TEXTURE_BUFFER, max<size_t>(lights.size(), 1) * sizeof(PointLight), lights.data(), GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, this->texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, this->buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    this->count = lights.size();
+    this->lights = lights;
+}
+
+// Deferred renderer
+
+static void allocate(GLuint texture, GLenum format, GLenum layout, GLenum type, int width, int height) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, layout, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+DeferredRenderer::DeferredRenderer()
+        : gbuffer(FramebufferHandle::create()), albedo(TextureHandle::create()), normal(TextureHandle::create()),
+          accumulation(FramebufferHandle::create()), light(TextureHandle::create()),
+          width(0), height(0),
+          volumeVAO(VertexArrayHandle::create()), volumeVertices(BufferHandle::create()),
+          volumeIndices(BufferHandle::create()), emptyVAO(VertexArrayHandle::create()) {
+    // Cube of half size 1 around the light, faces wound counter-clockwise from outside
+    const float corners[] = {
+        -1.f, -1.f, -1.f,   1.f, -1.f, -1.f,  -1.f,  1.f, -1.f,   1.f,  1.f, -1.f,
+        -1.f, -1.f,  1.f,   1.f, -1.f,  1.f,  -1.f,  1.f,  1.f,   1.f,  1.f,  1.f,
+    };
+    const unsigned char faces[] = {
+        0, 4, 6, 0, 6, 2,   1, 3, 7, 1, 7, 5,
+        0, 1, 5, 0, 5, 4,   2, 6, 7, 2, 7, 3,
+        0, 2, 3, 0, 3, 1,   4, 5, 7, 4, 7, 6,
+    };
+    glBindVertexArray(this->volumeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, this->volumeVertices);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->volumeIndices);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+
+        // Light per instance, pointed at its buffer in shade()
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    this->ambientProgram = new ShaderProgram("fullscreen.glsl", "deferred_ambient.glsl");
+    this->lightProgram = new ShaderProgram("light_volume_vertex.glsl", "light_volume.glsl");
+    this->resolveProgram = new ShaderProgram("fullscreen.glsl", "deferred_resolve.glsl");
+}
+
+DeferredRenderer::~DeferredRenderer() {
+    delete this->ambientProgram;
+    delete this->lightProgram;
+    delete this->resolveProgram;
+}
+
+void DeferredRenderer::resize(const RenderTarget &target) {
+    if (target.width == this->width && target.height == this->height) {
+        return;
+    }
+    this->width = target.width;
+    this->height = target.height;
+
+    allocate(this->albedo, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, this->width, this->height);
+    allocate(this->normal, GL_RG16_SNORM, GL_RG, GL_SHORT, this->width, this->height);
+    allocate(this->light, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, this->width, this->height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->gbuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->albedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, this->normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depth, 0);
+    const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, buffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "ERROR::DEFERRED::GBUFFER_INCOMPLETE" << endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->accumulation);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->light, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "ERROR::DEFERRED::ACCUMULATION_INCOMPLETE" << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::bindGBuffer() {
+    glBindFramebuffer(GL_FRAMEBUFFER, this->gbuffer);
+    glViewport(0, 0, this->width, this->height);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void DeferredRenderer::shade(RenderTarget &target, const LightBuffer &lights, const float *viewProjection,
+        const float eye[3]) {
+    glm::mat4 inverseViewProjection = glm::inverse(glm::make_mat4(viewProjection));
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    // G-buffer & depth
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, this->albedo);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, this->normal);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, target.depth);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, this->light);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Ambient & sun light every covered pixel once
+    glBindFramebuffer(GL_FRAMEBUFFER, this->accumulation);
+    glViewport(0, 0, this->width, this->height);
+    glBindVertexArray(this->emptyVAO);
+    this->ambientProgram->use();
+    this->ambientProgram->set1i("albedoRoughness", 0);
+    this->ambientProgram->set1i("octNormal", 1);
+    this->ambientProgram->set1i("depth", 2);
+    this->ambientProgram->setMatrix4fv("inverseViewProjection", 1, glm::value_ptr(inverseViewProjection));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // Point lights add up over their volumes
+    if (lights.count > 0) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+
+        glBindVertexArray(this->volumeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, lights.buffer);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void*)0);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(PointLight), (void*)(4 * sizeof(float)));
+
+        this->lightProgram->use();
+        this->lightProgram->setMatrix4fv("viewProjection", 1, viewProjection);
+        this->lightProgram->setMatrix4fv("inverseViewProjection", 1, glm::value_ptr(inverseViewProjection));
+        this->lightProgram->set3f("eye", eye[0], eye[1], eye[2]);
+        this->lightProgram->set1i("albedoRoughness", 0);
+        this->lightProgram->set1i("octNormal", 1);
+        this->lightProgram->set1i("depth", 2);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0, lights.count);
+
+        glDisable(GL_CULL_FACE);
+        glCullFace(GL_BACK);
+        glDisable(GL_BLEND);
+    }
+
+    // Into the render target, leaving its background where nothing was drawn
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glBindVertexArray(this->emptyVAO);
+    this->resolveProgram->use();
+    this->resolveProgram->set1i("light", 3);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+}
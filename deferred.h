@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "context.h"
+#include "framebuffer.h"
+#include "glhandle.h"
+#include "shader.h"
+
+// Laid out as two vec4s, for both instance attributes and the forward
+// path's buffer texture
+struct PointLight {
+    float position[3];
+    float radius;  // Light reaches zero here
+    float color[3];
+    float intensity;
+};
+
+// Random lights of radius about radius inside the box center +- extent
+std::vector<PointLight> scatterLights(size_t count, const float center[3], const float extent[3], float radius,
+        unsigned seed = 1);
+
+// Point lights on the GPU: per-instance data of light volumes, also
+// readable as an RGBA32F buffer texture (2 texels per light)
+struct LightBuffer {
+    BufferHandle buffer;
+    TextureHandle texture;
+    size_t count;
+    std::vector<PointLight> lights;  // CPU copy
+
+    LightBuffer();
+
+    void set(const std::vector<PointLight> &lights);
+};
+
+// Deferred shading. The geometry pass writes a compact G-buffer into
+// the render target's depth and two color textures:
+//   RGBA8       albedo, roughness
+//   RG16_SNORM  octahedral world normal
+// Lights are then added up in an RGBA16F buffer, each drawn as the back
+// faces of a cube around its sphere (so it also works with the camera
+// inside), and finally gamma encoded into the render target's color.
+struct DeferredRenderer {
+    FramebufferHandle gbuffer;
+    TextureHandle albedo;
+    TextureHandle normal;
+    FramebufferHandle accumulation;
+    TextureHandle light;
+    int width;
+    int height;
+
+    VertexArrayHandle volumeVAO;
+    BufferHandle volumeVertices;
+    BufferHandle volumeIndices;
+    VertexArrayHandle emptyVAO;
+
+    ShaderProgram *ambientProgram;
+    ShaderProgram *lightProgram;
+    ShaderProgram *resolveProgram;
+
+    DeferredRenderer();
+    ~DeferredRenderer();
+
+    // Follows target's size; target's depth becomes the G-buffer's
+    void resize(const RenderTarget &target);
+
+    // Binds and clears the G-buffer for the geometry pass
+    void bindGBuffer();
+
+    // Lights the G-buffer into target. Shadow uniforms of ambientProgram are up to the caller.
+    void shade(RenderTarget &target, const LightBuffer &lights, const float *viewProjection, const float eye[3]);
+};
@@ -0,0 +1,32 @@
+#version 330 core
+
+// Ambient & shadowed sun over the whole G-buffer. Alpha marks covered pixels for the resolve.
+
+#include "lighting.glsl"
+#include "octahedral.glsl"
+
+uniform sampler2D albedoRoughness;
+uniform sampler2D octNormal;
+uniform sampler2D depth;
+uniform mat4 inverseViewProjection;
+
+out vec4 fragColor;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float z = texelFetch(depth, texel, 0).r;
+    if (z == 1.0) {
+        fragColor = vec4(0.0);
+        return;
+    }
+
+    // World position back from depth
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(depth, 0));
+    vec4 p = inverseViewProjection * vec4(vec3(uv, z) * 2.0 - 1.0, 1.0);
+    vec3 position = p.xyz / p.w;
+
+    vec3 albedo = texelFetch(albedoRoughness, texel, 0).rgb;
+    vec3 n = octDecode(texelFetch(octNormal, texel, 0).rg);
+    vec3 sun = SUN_COLOR * max(dot(n, SUN_DIRECTION), 0.0) * sunShadow(position, n);
+    fragColor = vec4(albedo * (AMBIENT + sun), 1.0);
+}
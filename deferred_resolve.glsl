@@ -0,0 +1,15 @@
+#version 330 core
+
+// Gamma encodes the accumulated light, keeping the background where nothing was drawn
+
+uniform sampler2D light;
+
+out vec4 fragColor;
+
+void main() {
+    vec4 color = texelFetch(light, ivec2(gl_FragCoord.xy), 0);
+    if (color.a == 0.0) {
+        discard;
+    }
+    fragColor = vec4(pow(color.rgb, vec3(0.4545)), 1.0);
+}
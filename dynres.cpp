@@ -0,0 +1,33 @@
+#include "dynres.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+ResolutionScaler::ResolutionScaler(float targetMs, float minScale, float maxScale, float step)
+        : targetMs(targetMs), minScale(minScale), maxScale(maxScale), step(step),
+          kp(0.2f), ki(0.05f), kd(0.05f),
+          scale(maxScale), current(maxScale), error(0.f), previousError(0.f) {
+}
+
+float ResolutionScaler::update(float gpuMs) {
+    // Positive with time to spare, negative when over budget
+    float e = (this->targetMs - gpuMs) / this->targetMs;
+
+    float delta = this->kp * (e - this->error)
+                + this->ki * e
+                + this->kd * (e - 2.f * this->error + this->previousError);
+    this->previousError = this->error;
+    this->error = e;
+
+    this->scale = min(max(this->scale + delta, this->minScale), this->maxScale);
+
+    // Move only once the output is a whole step away, or at its limits
+    if (fabsf(this->scale - this->current) >= this->step
+            || this->scale == this->minScale || this->scale == this->maxScale) {
+        float q = floorf(this->scale / this->step + 0.5f) * this->step;
+        this->current = min(max(q, this->minScale), this->maxScale);
+    }
+    return this->current;
+}
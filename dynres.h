@@ -0,0 +1,26 @@
+#pragma once
+
+// Render resolution scale driven by measured GPU frame time through a PID
+// controller. The scale applies to both axes, between minScale and
+// maxScale, and is quantized to steps with hysteresis so render targets
+// are only reallocated when it moves noticeably.
+struct ResolutionScaler {
+    float targetMs;
+    float minScale;
+    float maxScale;
+    float step;
+
+    // Gains on the error relative to targetMs; velocity form, so the
+    // output can saturate at its limits without integral windup
+    float kp, ki, kd;
+
+    float scale;         // Continuous controller output
+    float current;       // Quantized scale to render at
+    float error;         // Last two errors
+    float previousError;
+
+    ResolutionScaler(float targetMs, float minScale = 0.5f, float maxScale = 1.f, float step = 1.f / 32.f);
+
+    // Feeds a GPU frame time, returns the scale to render at
+    float update(float gpuMs);
+};
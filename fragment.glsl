@@ -1,9 +1,31 @@
 #version 330 core
 
+// Forward shading: every fragment loops over all the lights
+
+#include "lighting.glsl"
+
+in vec3 normal;
+in vec3 worldPosition;
+
+uniform samplerBuffer lights;  // Position & radius, color & intensity
+uniform int lightCount;
+uniform vec3 eye;
+
 out vec4 fragColor;
 
+const vec3 ALBEDO = vec3(1.0, 0.0, 0.0);
+const float ROUGHNESS = 0.5;
+
 void main() {
-    vec3 color = vec3(1., 0., 0.);
+    vec3 n = normalize(normal);
+    vec3 v = normalize(eye - worldPosition);
+
+    vec3 sun = SUN_COLOR * max(dot(n, SUN_DIRECTION), 0.0) * sunShadow(worldPosition, n);
+    vec3 color = ALBEDO * (AMBIENT + sun);
+    for (int i = 0; i < lightCount; ++i) {
+        color += pointLight(worldPosition, n, v, ALBEDO, ROUGHNESS,
+                texelFetch(lights, 2 * i), texelFetch(lights, 2 * i + 1));
+    }
     color = pow(color, vec3(0.4545));
 
     fragColor = vec4(color, 1.);
@@ -0,0 +1,107 @@
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+int RenderTarget::maxSamples() {
+    GLint samples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES, &samples);
+    return max(samples, 1);
+}
+
+RenderTarget::RenderTarget()
+        : framebuffer(FramebufferHandle::create()), color(TextureHandle::create()), depth(TextureHandle::create()),
+          width(0), height(0), multisampleFramebuffer(FramebufferHandle::create()),
+          multisampleColor(RenderbufferHandle::create()), multisampleDepth(RenderbufferHandle::create()), samples(1) {
+}
+
+void RenderTarget::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+
+    glBindTexture(GL_TEXTURE_2D, this->color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D, this->depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->depth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "ERROR::RENDER_TARGET::INCOMPLETE" << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    this->allocateMultisample();
+}
+
+void RenderTarget::setSamples(int samples) {
+    samples = min(max(samples, 1), maxSamples());
+    if (samples == this->samples) {
+        return;
+    }
+    this->samples = samples;
+    this->allocateMultisample();
+}
+
+void RenderTarget::allocateMultisample() {
+    if (this->samples == 1 || this->width == 0) {
+        return;
+    }
+
+    // Same formats as the textures, which a resolving blit requires
+    glBindRenderbuffer(GL_RENDERBUFFER, this->multisampleColor);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, this->samples, GL_RGBA8, this->width, this->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->multisampleDepth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, this->samples, GL_DEPTH_COMPONENT32F, this->width, this->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->multisampleFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->multisampleColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->multisampleDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "ERROR::RENDER_TARGET::MULTISAMPLE_INCOMPLETE" << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderTarget::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, this->samples > 1 ? this->multisampleFramebuffer : this->framebuffer);
+    glViewport(0, 0, this->width, this->height);
+}
+
+void RenderTarget::resolve() {
+    if (this->samples == 1) {
+        return;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->multisampleFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->framebuffer);
+    glBlitFramebuffer(0, 0, this->width, this->height,
+                      0, 0, this->width, this->height,
+                      GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderTarget::blitToScreen(int screenWidth, int screenHeight) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, this->width, this->height,
+                      0, 0, screenWidth, screenHeight,
+                      GL_COLOR_BUFFER_BIT,
+                      screenWidth == this->width && screenHeight == this->height ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
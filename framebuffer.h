@@ -0,0 +1,42 @@
+#pragma once
+
+#include "context.h"
+#include "glhandle.h"
+
+// Offscreen color & depth textures that later passes can sample.
+// With MSAA the scene is drawn into multisampled renderbuffers instead
+// and resolve() blits them down into the textures.
+struct RenderTarget {
+    FramebufferHandle framebuffer;
+    TextureHandle color;
+    TextureHandle depth;
+    int width;
+    int height;
+
+    FramebufferHandle multisampleFramebuffer;
+    RenderbufferHandle multisampleColor;
+    RenderbufferHandle multisampleDepth;
+    int samples;  // 1 without MSAA
+
+    static int maxSamples();
+
+    RenderTarget();
+
+    // Reallocates textures if size changed
+    void resize(int width, int height);
+
+    // Clamped to what the driver supports; reallocates if the count changed
+    void setSamples(int samples);
+
+    // Multisampled framebuffer with MSAA
+    void bind();
+
+    // Averages the samples into color, and takes one sample's depth; no-op without MSAA
+    void resolve();
+
+    // Copies color to the default framebuffer, scaling to its size
+    void blitToScreen(int screenWidth, int screenHeight);
+
+    // Internal
+    void allocateMultisample();
+};
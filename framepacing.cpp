@@ -0,0 +1,101 @@
+#include "framepacing.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+// Sleeping stops this long before a deadline, to absorb SDL_Delay overshoot
+static const double SPIN_SECONDS = 0.002;
+
+SwapMode setSwapMode(SwapMode mode) {
+    if (mode == SWAP_ADAPTIVE && SDL_GL_SetSwapInterval(-1) == 0) {
+        return SWAP_ADAPTIVE;
+    }
+    if (mode != SWAP_IMMEDIATE && SDL_GL_SetSwapInterval(1) == 0) {
+        return SWAP_VSYNC;
+    }
+    SDL_GL_SetSwapInterval(0);
+    return SWAP_IMMEDIATE;
+}
+
+const char *swapModeName(SwapMode mode) {
+    switch (mode) {
+        case SWAP_IMMEDIATE: return "off";
+        case SWAP_VSYNC:     return "on";
+        case SWAP_ADAPTIVE:  return "adaptive";
+    }
+    return "unknown";
+}
+
+// Frame pacer
+
+FramePacer::FramePacer(double fps) : frequency(SDL_GetPerformanceFrequency()) {
+    this->interval = fps > 0.0 ? Uint64(this->frequency / fps) : 0;
+    this->deadline = SDL_GetPerformanceCounter() + this->interval;
+}
+
+void FramePacer::wait() {
+    if (this->interval == 0) {
+        return;
+    }
+
+    Uint64 spin = Uint64(this->frequency * SPIN_SECONDS);
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now + spin < this->deadline) {
+        SDL_Delay(Uint32((this->deadline - spin - now) * 1000 / this->frequency));
+    }
+    while ((now = SDL_GetPerformanceCounter()) < this->deadline) {
+    }
+
+    // Keep a steady cadence, but don't try to catch up after a long frame
+    this->deadline += this->interval;
+    if (this->deadline < now) {
+        this->deadline = now + this->interval;
+    }
+}
+
+// Latency
+
+void LatencyTracker::submitted(Uint32 inputTime) {
+    if (inputTime == 0) {
+        return;
+    }
+    Frame frame = { QueryHandle::create(), inputTime };
+    glQueryCounter(frame.query, GL_TIMESTAMP);
+    this->frames.push_back(move(frame));
+}
+
+void LatencyTracker::poll() {
+    bool calibrated = false;
+    GLint64 gpuNow = 0;
+    Uint32 now = 0;
+    while (!this->frames.empty()) {
+        Frame &frame = this->frames.front();
+        GLint available = 0;
+        glGetQueryObjectiv(frame.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        if (!calibrated) {
+            glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+            now = SDL_GetTicks();
+            calibrated = true;
+        }
+        GLuint64 finished = 0;
+        glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &finished);
+
+        // Ticks when the GPU got there: now, less how long ago that was on its clock
+        double ago = (gpuNow - (GLint64)finished) / 1e6;
+        double latency = max(now - ago - frame.inputTime, 0.0);
+        this->total += latency;
+        this->worst = max(this->worst, latency);
+        ++this->samples;
+
+        this->frames.pop_front();
+    }
+}
+
+void LatencyTracker::clear() {
+    this->frames.clear();
+}
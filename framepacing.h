@@ -0,0 +1,60 @@
+#pragma once
+
+#include <deque>
+
+#include "context.h"
+#include "glhandle.h"
+
+enum SwapMode {
+    SWAP_IMMEDIATE,  // No vsync
+    SWAP_VSYNC,
+    SWAP_ADAPTIVE,   // Vsync, but late frames tear instead of waiting a whole refresh
+};
+
+// Falls back from adaptive to plain vsync where unsupported.
+// Returns the mode that was set.
+SwapMode setSwapMode(SwapMode mode);
+const char *swapModeName(SwapMode mode);
+
+// Caps the frame rate by sleeping. SDL_Delay is only ms accurate and may
+// oversleep, so it sleeps to shortly before the deadline and spins the rest.
+struct FramePacer {
+    Uint64 frequency;
+    Uint64 interval;   // Counter ticks per frame, 0 for no limit
+    Uint64 deadline;
+
+    FramePacer(double fps);
+
+    // Returns once the next frame is due
+    void wait();
+};
+
+// Time from an input event to the GPU finishing the frame that shows its
+// effect. Display scanout comes on top of it and can't be observed here.
+// A GL_TIMESTAMP query stamps completion on the GPU clock, brought to SDL
+// ticks through the GL's current time when the result is read.
+struct LatencyTracker {
+    struct Frame {
+        QueryHandle query;
+        Uint32 inputTime;  // SDL ticks of the oldest input the frame reacts to
+    };
+
+    std::deque<Frame> frames;
+    double total;  // Ms
+    double worst;
+    int samples;
+
+    LatencyTracker() : total(0.0), worst(0.0), samples(0) {}
+
+    // After the swap of a frame that reacts to input from inputTime
+    void submitted(Uint32 inputTime);
+
+    // Collects finished frames
+    void poll();
+
+    // Drops frames in flight, while the context is still current
+    void clear();
+
+    double average() const { return this->samples ? this->total / this->samples : 0.0; }
+    void reset() { this->total = this->worst = 0.0; this->samples = 0; }
+};
@@ -0,0 +1,27 @@
+#include "fxaa.h"
+
+Fxaa::Fxaa() : emptyVAO(VertexArrayHandle::create()) {
+    this->program = new ShaderProgram("fullscreen.glsl", "fxaa.glsl");
+}
+
+Fxaa::~Fxaa() {
+    delete this->program;
+}
+
+void Fxaa::apply(const RenderTarget &source, int screenWidth, int screenHeight) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screenWidth, screenHeight);
+    glDisable(GL_DEPTH_TEST);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, source.color);
+    glBindVertexArray(this->emptyVAO);
+    this->program->use();
+    this->program->set1i("color", 0);
+    this->program->set2f("texel", 1.f / source.width, 1.f / source.height);
+    this->program->set2f("screenSize", float(screenWidth), float(screenHeight));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+}
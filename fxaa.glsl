@@ -0,0 +1,52 @@
+#version 330 core
+
+// FXAA-style antialiasing. Where the luma contrast around a pixel is high
+// enough, the edge direction is estimated from its diagonal neighbours and
+// the color is averaged along it, falling back to the shorter average when
+// the longer one steps off the edge. Scales to the window on the way.
+
+uniform sampler2D color;
+uniform vec2 texel;       // 1 / source size
+uniform vec2 screenSize;
+
+out vec4 fragColor;
+
+const float EDGE_THRESHOLD = 0.125;    // Contrast relative to the brightest neighbour
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+const float SPAN_MAX = 8.0;            // Texels
+
+float luma(vec3 c) {
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / screenSize;
+    vec3 rgbM = texture(color, uv).rgb;
+    float lumaM = luma(rgbM);
+    float lumaNW = luma(texture(color, uv + vec2(-1.0, -1.0) * texel).rgb);
+    float lumaNE = luma(texture(color, uv + vec2( 1.0, -1.0) * texel).rgb);
+    float lumaSW = luma(texture(color, uv + vec2(-1.0,  1.0) * texel).rgb);
+    float lumaSE = luma(texture(color, uv + vec2( 1.0,  1.0) * texel).rgb);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD)) {
+        fragColor = vec4(rgbM, 1.0);
+        return;
+    }
+
+    // Along the edge, scaled so the smaller component is about a texel
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float scale = 1.0 / (min(abs(dir.x), abs(dir.y)) + reduce);
+    dir = clamp(dir * scale, -SPAN_MAX, SPAN_MAX) * texel;
+
+    vec3 shortAverage = 0.5 * (texture(color, uv + dir * (1.0 / 3.0 - 0.5)).rgb
+                             + texture(color, uv + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 longAverage = 0.5 * shortAverage + 0.25 * (texture(color, uv - dir * 0.5).rgb
+                                                  + texture(color, uv + dir * 0.5).rgb);
+    float lumaLong = luma(longAverage);
+    fragColor = vec4(lumaLong < lumaMin || lumaLong > lumaMax ? shortAverage : longAverage, 1.0);
+}
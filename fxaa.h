@@ -0,0 +1,20 @@
+#pragma once
+
+#include "context.h"
+#include "framebuffer.h"
+#include "glhandle.h"
+#include "shader.h"
+
+// FXAA-style post antialiasing: a single fullscreen pass that finds edges
+// from luma contrast and blends along them. Costs the same per pixel
+// however much geometry there is, and replaces the blit to the window.
+struct Fxaa {
+    ShaderProgram *program;
+    VertexArrayHandle emptyVAO;
+
+    Fxaa();
+    ~Fxaa();
+
+    // Draws source's color to the default framebuffer, scaling to its size
+    void apply(const RenderTarget &source, int screenWidth, int screenHeight);
+};
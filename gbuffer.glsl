@@ -0,0 +1,19 @@
+#version 330 core
+
+// Deferred geometry pass: material & normal only, lighting comes later
+
+#include "octahedral.glsl"
+
+in vec3 normal;
+in vec3 worldPosition;
+
+layout (location = 0) out vec4 albedoRoughness;
+layout (location = 1) out vec2 octNormal;  // RG16_SNORM
+
+const vec3 ALBEDO = vec3(1.0, 0.0, 0.0);
+const float ROUGHNESS = 0.5;
+
+void main() {
+    albedoRoughness = vec4(ALBEDO, ROUGHNESS);
+    octNormal = octEncode(normalize(normal));
+}
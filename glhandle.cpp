@@ -0,0 +1,71 @@
+#include "glhandle.h"
+
+using namespace std;
+
+DeletionQueue deletionQueue;
+
+GLuint createObject(HandleType type) {
+    GLuint name = 0;
+    switch (type) {
+        case HANDLE_BUFFER:       glGenBuffers(1, &name); break;
+        case HANDLE_TEXTURE:      glGenTextures(1, &name); break;
+        case HANDLE_FRAMEBUFFER:  glGenFramebuffers(1, &name); break;
+        case HANDLE_RENDERBUFFER: glGenRenderbuffers(1, &name); break;
+        case HANDLE_VERTEX_ARRAY: glGenVertexArrays(1, &name); break;
+        case HANDLE_QUERY:        glGenQueries(1, &name); break;
+        case HANDLE_SAMPLER:      glGenSamplers(1, &name); break;
+        case HANDLE_PROGRAM:      name = glCreateProgram(); break;
+    }
+    return name;
+}
+
+void deleteObject(HandleType type, GLuint name) {
+    switch (type) {
+        case HANDLE_BUFFER:       glDeleteBuffers(1, &name); break;
+        case HANDLE_TEXTURE:      glDeleteTextures(1, &name); break;
+        case HANDLE_FRAMEBUFFER:  glDeleteFramebuffers(1, &name); break;
+        case HANDLE_RENDERBUFFER: glDeleteRenderbuffers(1, &name); break;
+        case HANDLE_VERTEX_ARRAY: glDeleteVertexArrays(1, &name); break;
+        case HANDLE_QUERY:        glDeleteQueries(1, &name); break;
+        case HANDLE_SAMPLER:      glDeleteSamplers(1, &name); break;
+        case HANDLE_PROGRAM:      glDeleteProgram(name); break;
+    }
+}
+
+void DeletionQueue::endFrame() {
+    if (!this->pending.empty()) {
+        Batch batch;
+        batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        batch.objects.swap(this->pending);
+        this->batches.push_back(move(batch));
+    }
+
+    // Frames finish in order, so stop at the first one still running
+    while (!this->batches.empty()) {
+        Batch &batch = this->batches.front();
+        GLenum status = glClientWaitSync(batch.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(batch.fence);
+        for (const Object &object : batch.objects) {
+            deleteObject(object.first, object.second);
+        }
+        this->deleted += batch.objects.size();
+        this->batches.pop_front();
+    }
+}
+
+void DeletionQueue::flush() {
+    glFinish();
+    for (Batch &batch : this->batches) {
+        glDeleteSync(batch.fence);
+        this->pending.insert(this->pending.end(), batch.objects.begin(), batch.objects.end());
+    }
+    this->batches.clear();
+    for (const Object &object : this->pending) {
+        deleteObject(object.first, object.second);
+    }
+    this->deleted += this->pending.size();
+    this->pending.clear();
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "context.h"
+
+enum HandleType {
+    HANDLE_BUFFER,
+    HANDLE_TEXTURE,
+    HANDLE_FRAMEBUFFER,
+    HANDLE_RENDERBUFFER,
+    HANDLE_VERTEX_ARRAY,
+    HANDLE_QUERY,
+    HANDLE_SAMPLER,
+    HANDLE_PROGRAM,
+};
+
+GLuint createObject(HandleType type);
+void deleteObject(HandleType type, GLuint name);
+
+// GL objects released while commands still in flight may use them.
+// Releases of a frame are fenced at endFrame() and deleted a few frames
+// later, once the fence has signaled, without ever waiting on the GPU.
+struct DeletionQueue {
+    typedef std::pair<HandleType, GLuint> Object;
+
+    struct Batch {
+        GLsync fence;
+        std::vector<Object> objects;
+    };
+
+    std::vector<Object> pending;
+    std::deque<Batch> batches;
+    size_t deleted;
+
+    DeletionQueue() : deleted(0) {}
+
+    void push(HandleType type, GLuint name) { this->pending.push_back(Object(type, name)); }
+
+    // Fences this frame's releases, deletes those of finished frames
+    void endFrame();
+
+    // Deletes everything after waiting for the GPU, before the context goes away
+    void flush();
+};
+
+extern DeletionQueue deletionQueue;
+
+// Owning, move-only GL object name. Destroying or resetting it hands the
+// object to deletionQueue.
+template <HandleType T>
+struct Handle {
+    GLuint name;
+
+    Handle() : name(0) {}
+    explicit Handle(GLuint name) : name(name) {}
+
+    Handle(const Handle&) = delete;
+    Handle &operator=(const Handle&) = delete;
+
+    Handle(Handle &&other) : name(other.name) { other.name = 0; }
+    Handle &operator=(Handle &&other) {
+        if (this != &other) {
+            this->reset(other.name);
+            other.name = 0;
+        }
+        return *this;
+    }
+
+    ~Handle() { this->reset(); }
+
+    static Handle create() { return Handle(createObject(T)); }
+
+    void reset(GLuint name = 0) {
+        if (this->name != 0) {
+            deletionQueue.push(T, this->name);
+        }
+        this->name = name;
+    }
+
+    // Gives up ownership without deleting
+    GLuint release() {
+        GLuint name = this->name;
+        this->name = 0;
+        return name;
+    }
+
+    operator GLuint() const { return this->name; }
+};
+
+typedef Handle<HANDLE_BUFFER> BufferHandle;
+typedef Handle<HANDLE_TEXTURE> TextureHandle;
+typedef Handle<HANDLE_FRAMEBUFFER> FramebufferHandle;
+typedef Handle<HANDLE_RENDERBUFFER> RenderbufferHandle;
+typedef Handle<HANDLE_VERTEX_ARRAY> VertexArrayHandle;
+typedef Handle<HANDLE_QUERY> QueryHandle;
+typedef Handle<HANDLE_SAMPLER> SamplerHandle;
+typedef Handle<HANDLE_PROGRAM> ProgramHandle;
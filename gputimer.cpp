@@ -0,0 +1,66 @@
+#include "gputimer.h"
+
+const int GpuTimer::QUERIES;
+
+GpuTimer::GpuTimer() : next(0), oldest(0), running(false), milliseconds(0.f), splitMilliseconds(0.f) {
+    for (int i = 0; i < QUERIES; ++i) {
+        for (int s = 0; s < STAMPS; ++s) {
+            this->queries[i][s] = QueryHandle::create();
+        }
+        this->pending[i] = false;
+        this->splitted[i] = false;
+    }
+}
+
+void GpuTimer::begin() {
+    if (this->pending[this->next]) {
+        return;
+    }
+    glQueryCounter(this->queries[this->next][STAMP_BEGIN], GL_TIMESTAMP);
+    this->splitted[this->next] = false;
+    this->running = true;
+}
+
+void GpuTimer::split() {
+    if (!this->running) {
+        return;
+    }
+    glQueryCounter(this->queries[this->next][STAMP_SPLIT], GL_TIMESTAMP);
+    this->splitted[this->next] = true;
+}
+
+void GpuTimer::end() {
+    if (!this->running) {
+        return;
+    }
+    glQueryCounter(this->queries[this->next][STAMP_END], GL_TIMESTAMP);
+    this->pending[this->next] = true;
+    this->next = (this->next + 1) % QUERIES;
+    this->running = false;
+}
+
+bool GpuTimer::poll() {
+    bool updated = false;
+    while (this->pending[this->oldest]) {
+        // Timestamps complete in order, the end one last
+        const QueryHandle *stamps = this->queries[this->oldest];
+        GLint available = 0;
+        glGetQueryObjectiv(stamps[STAMP_END], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 begin = 0, split = 0, end = 0;
+        glGetQueryObjectui64v(stamps[STAMP_BEGIN], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(stamps[STAMP_END], GL_QUERY_RESULT, &end);
+        split = end;
+        if (this->splitted[this->oldest]) {
+            glGetQueryObjectui64v(stamps[STAMP_SPLIT], GL_QUERY_RESULT, &split);
+        }
+        this->milliseconds = (end - begin) / 1e6f;
+        this->splitMilliseconds = (split - begin) / 1e6f;
+        this->pending[this->oldest] = false;
+        this->oldest = (this->oldest + 1) % QUERIES;
+        updated = true;
+    }
+    return updated;
+}
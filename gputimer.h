@@ -0,0 +1,37 @@
+#pragma once
+
+#include "context.h"
+#include "glhandle.h"
+
+// GPU time of a span of commands, from GL_TIMESTAMP queries at its start,
+// an optional split point & its end. Results arrive a few frames late;
+// a ring of queries keeps reading them from ever waiting on the GPU.
+struct GpuTimer {
+    static const int QUERIES = 4;
+
+    enum Stamp {
+        STAMP_BEGIN,
+        STAMP_SPLIT,
+        STAMP_END,
+        STAMPS,
+    };
+
+    QueryHandle queries[QUERIES][STAMPS];
+    bool pending[QUERIES];
+    bool splitted[QUERIES];
+    int next;      // Queries the next begin() uses
+    int oldest;    // Oldest pending queries
+    bool running;
+    float milliseconds;       // Latest result, begin to end
+    float splitMilliseconds;  // And begin to split, the whole span without a split
+
+    GpuTimer();
+
+    // Does nothing while all queries are still in flight
+    void begin();
+    void split();
+    void end();
+
+    // Collects finished queries; returns whether milliseconds got updated
+    bool poll();
+};
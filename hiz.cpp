@@ -0,0 +1,169 @@
+#include "hiz.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+bool HiZ::supported() {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 4 || (major == 4 && minor >= 3);
+}
+
+HiZ::HiZ()
+        : framebuffer(FramebufferHandle::create()), emptyVAO(VertexArrayHandle::create()),
+          width(0), height(0), levels(0),
+          boundsBuffer(BufferHandle::create()), drawsBuffer(BufferHandle::create()),
+          drawLodsBuffer(BufferHandle::create()), lodsBuffer(BufferHandle::create()),
+          commandBuffer(BufferHandle::create()), capacity(0), valid(false) {
+    this->reduceProgram = new ShaderProgram("fullscreen.glsl", "hiz_reduce.glsl");
+    this->cullProgram = new ShaderProgram("hiz_cull.glsl");
+}
+
+HiZ::~HiZ() {
+    delete this->reduceProgram;
+    delete this->cullProgram;
+}
+
+void HiZ::setBounds(const ObjectBounds &bounds) {
+    size_t n = bounds.size();
+
+    vector<float> spheres(n * 4);
+    for (size_t i = 0; i < n; ++i) {
+        spheres[i * 4 + 0] = bounds.centerX[i];
+        spheres[i * 4 + 1] = bounds.centerY[i];
+        spheres[i * 4 + 2] = bounds.centerZ[i];
+        spheres[i * 4 + 3] = bounds.radius[i];
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, spheres.size() * sizeof(float), spheres.data(), GL_STATIC_DRAW);
+
+    // At most one draw per object
+    this->capacity = n;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->drawsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, n * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->drawLodsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, n * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, n * 5 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void HiZ::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    this->levels = 1;
+    while ((max(width, height) >> this->levels) > 0) {
+        ++this->levels;
+    }
+    this->valid = false;
+
+    // Immutable storage can't be resized; the old pyramid may still be read by queued culls
+    this->texture = TextureHandle::create();
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+    glTexStorage2D(GL_TEXTURE_2D, this->levels, GL_R32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void HiZ::build(GLuint depthTexture, int width, int height, const float *viewProjection) {
+    this->resize(width, height);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glBindVertexArray(this->emptyVAO);
+    this->reduceProgram->use();
+    this->reduceProgram->set1i("source", 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    int w = width, h = height;
+    for (int level = 0; level < this->levels; ++level) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, level);
+
+        if (level == 0) {
+            // Plain copy of the depth buffer
+            glBindTexture(GL_TEXTURE_2D, depthTexture);
+            this->reduceProgram->set1i("reduce", 0);
+        } else {
+            // Read only the previous level so the one being written is not sampled
+            glBindTexture(GL_TEXTURE_2D, this->texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            this->reduceProgram->set1i("reduce", 1);
+        }
+        this->reduceProgram->set2i("sourceSize", w, h);
+
+        w = level == 0 ? w : max(w / 2, 1);
+        h = level == 0 ? h : max(h / 2, 1);
+        glViewport(0, 0, w, h);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, this->levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_DEPTH_TEST);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    memcpy(this->viewProjection, viewProjection, sizeof(this->viewProjection));
+    this->valid = true;
+}
+
+void HiZ::setLods(const MeshLod *lods, size_t count, GLuint firstIndex, GLint baseVertex) {
+    vector<GLint> ranges(count * 4);
+    for (size_t l = 0; l < count; ++l) {
+        ranges[l * 4 + 0] = firstIndex + lods[l].firstIndex;
+        ranges[l * 4 + 1] = lods[l].indexCount;
+        ranges[l * 4 + 2] = baseVertex;
+        ranges[l * 4 + 3] = 0;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lodsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, ranges.size() * sizeof(GLint), ranges.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void HiZ::cull(const unsigned *draws, const unsigned *drawLods, size_t count) {
+    count = min(count, this->capacity);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->drawsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GLuint), draws);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->drawLodsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GLuint), drawLods);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->drawsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, this->drawLodsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, this->lodsBuffer);
+
+    this->cullProgram->use();
+    this->cullProgram->setMatrix4fv("viewProjection", 1, this->viewProjection);
+    this->cullProgram->set2i("hizSize", this->width, this->height);
+    this->cullProgram->set1i("hizLevels", this->levels);
+    this->cullProgram->set1i("hizValid", this->valid);
+    this->cullProgram->set1ui("drawCount", count);
+    this->cullProgram->set1i("hiz", 0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+
+    glDispatchCompute((count + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+#include "context.h"
+#include "culling.h"
+#include "glhandle.h"
+#include "mesh.h"
+#include "shader.h"
+
+// Hierarchical-Z occlusion culling on the GPU (needs OpenGL 4.3).
+//
+// At the end of a frame the depth buffer is reduced into a max-depth mip
+// pyramid. Next frame a compute shader tests object bounds against it
+// and writes one indirect draw command per object, with zero instances
+// for occluded ones.
+struct HiZ {
+    TextureHandle texture;
+    FramebufferHandle framebuffer;
+    VertexArrayHandle emptyVAO;
+    int width;
+    int height;
+    int levels;
+
+    ShaderProgram *reduceProgram;
+    ShaderProgram *cullProgram;
+
+    BufferHandle boundsBuffer;    // vec4 (center, radius) per object
+    BufferHandle drawsBuffer;     // Object index per draw
+    BufferHandle drawLodsBuffer;  // Lod index per draw
+    BufferHandle lodsBuffer;      // First index, index count & base vertex per lod
+    BufferHandle commandBuffer;   // DrawElementsIndirectCommand per draw
+    size_t capacity;
+
+    // Camera the pyramid was built with
+    float viewProjection[16];
+    bool valid;
+
+    static bool supported();
+
+    HiZ();
+    ~HiZ();
+
+    void setBounds(const ObjectBounds &bounds);
+
+    // Lods of a mesh whose indices start at firstIndex, vertices at baseVertex
+    void setLods(const MeshLod *lods, size_t count, GLuint firstIndex = 0, GLint baseVertex = 0);
+
+    // Fills commandBuffer for draws of object draws[i] at lod drawLods[i] as instance i
+    void cull(const unsigned *draws, const unsigned *drawLods, size_t count);
+
+    // Reduces depth texture to the pyramid used by the next cull()
+    void build(GLuint depthTexture, int width, int height, const float *viewProjection);
+
+    void resize(int width, int height);
+};
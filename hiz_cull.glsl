@@ -0,0 +1,72 @@
+#version 430 core
+
+layout (local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Bounds { vec4 bounds[]; };
+layout (std430, binding = 1) readonly buffer Draws { uint draws[]; };
+layout (std430, binding = 2) writeonly buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 3) readonly buffer DrawLods { uint drawLods[]; };
+layout (std430, binding = 4) readonly buffer Lods { ivec4 lods[]; };  // First index, index count, base vertex
+
+uniform mat4 viewProjection;
+uniform sampler2D hiz;
+uniform ivec2 hizSize;
+uniform int hizLevels;
+uniform bool hizValid;
+uniform uint drawCount;
+
+bool occluded(vec4 sphere) {
+    // Screen rectangle & nearest depth of the sphere's bounding box
+    vec2 lo = vec2(1.0);
+    vec2 hi = vec2(0.0);
+    float nearest = 1.0;
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0 : -1.0,
+                                                   (i & 2) != 0 ? 1.0 : -1.0,
+                                                   (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0) {
+            // Crosses the camera plane
+            return false;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        lo = min(lo, ndc.xy * 0.5 + 0.5);
+        hi = max(hi, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    lo = clamp(lo, 0.0, 1.0);
+    hi = clamp(hi, 0.0, 1.0);
+
+    // Level where the rectangle spans at most 2x2 texels
+    vec2 size = (hi - lo) * vec2(hizSize);
+    int level = clamp(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, hizLevels - 1);
+    ivec2 levelSize = max(hizSize >> level, ivec2(1));
+
+    // Levels are floor halved with odd edges folded into the last texel,
+    // so texels are found from base pixels, not by scaling to levelSize
+    ivec2 a = min(min(ivec2(lo * vec2(hizSize)), hizSize - 1) >> level, levelSize - 1);
+    ivec2 b = min(min(ivec2(hi * vec2(hizSize)), hizSize - 1) >> level, levelSize - 1);
+    float farthest = max(max(texelFetch(hiz, a, level).r, texelFetch(hiz, ivec2(b.x, a.y), level).r),
+                         max(texelFetch(hiz, ivec2(a.x, b.y), level).r, texelFetch(hiz, b, level).r));
+
+    return nearest > farthest;
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= drawCount) {
+        return;
+    }
+
+    bool visible = !hizValid || !occluded(bounds[draws[i]]);
+    ivec4 lod = lods[drawLods[i]];
+    commands[i] = DrawCommand(uint(lod.y), visible ? 1u : 0u, uint(lod.x), lod.z, i);
+}
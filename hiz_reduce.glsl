@@ -0,0 +1,40 @@
+#version 330 core
+
+uniform sampler2D source;
+uniform ivec2 sourceSize;
+uniform bool reduce;
+
+out float depth;
+
+float fetch(ivec2 p) {
+    return texelFetch(source, min(p, sourceSize - 1), 0).r;
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+
+    if (!reduce) {
+        depth = fetch(p);
+        return;
+    }
+
+    // Farthest of the 2x2 texels below
+    ivec2 s = p * 2;
+    float d = max(max(fetch(s), fetch(s + ivec2(1, 0))),
+                  max(fetch(s + ivec2(0, 1)), fetch(s + ivec2(1, 1))));
+
+    // With odd source sizes the last row/column also covers the extra texels
+    bool lastX = (sourceSize.x & 1) == 1 && p.x == sourceSize.x / 2 - 1;
+    bool lastY = (sourceSize.y & 1) == 1 && p.y == sourceSize.y / 2 - 1;
+    if (lastX) {
+        d = max(d, max(fetch(s + ivec2(2, 0)), fetch(s + ivec2(2, 1))));
+    }
+    if (lastY) {
+        d = max(d, max(fetch(s + ivec2(0, 2)), fetch(s + ivec2(1, 2))));
+    }
+    if (lastX && lastY) {
+        d = max(d, fetch(s + ivec2(2, 2)));
+    }
+
+    depth = d;
+}
@@ -0,0 +1,59 @@
+#include "indexbuffer.h"
+
+#include <cstdint>
+
+using namespace std;
+
+GLenum indexType(size_t vertexCount) {
+    if (vertexCount <= MAX_BYTE_VERTICES) {
+        return GL_UNSIGNED_BYTE;
+    }
+    if (vertexCount <= MAX_SHORT_VERTICES) {
+        return GL_UNSIGNED_SHORT;
+    }
+    return GL_UNSIGNED_INT;
+}
+
+size_t indexSize(GLenum type) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE: return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        default: return 4;
+    }
+}
+
+template<typename T>
+static void narrow(const unsigned *indices, size_t count, unsigned char *dst) {
+    T *out = (T*)dst;
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = (T)indices[i];
+    }
+}
+
+IndexBuffer::IndexBuffer(const unsigned *indices, size_t count, size_t vertexCount) {
+    this->type = indexType(vertexCount);
+    this->count = count;
+    this->data.resize(count * indexSize(this->type));
+
+    switch (this->type) {
+        case GL_UNSIGNED_BYTE: narrow<uint8_t>(indices, count, this->data.data()); break;
+        case GL_UNSIGNED_SHORT: narrow<uint16_t>(indices, count, this->data.data()); break;
+        default: narrow<uint32_t>(indices, count, this->data.data()); break;
+    }
+}
+
+template<typename T>
+static void widen(const void *data, size_t count, unsigned *out) {
+    const T *in = (const T*)data;
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = in[i];
+    }
+}
+
+void unpackIndices(const void *data, GLenum type, size_t count, unsigned *out) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE: widen<uint8_t>(data, count, out); break;
+        case GL_UNSIGNED_SHORT: widen<uint16_t>(data, count, out); break;
+        default: widen<uint32_t>(data, count, out); break;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "context.h"
+
+// Largest vertex counts drawn with 8 & 16 bit indices; the all ones
+// index of each type stays free for primitive restart
+const size_t MAX_BYTE_VERTICES = 255;
+const size_t MAX_SHORT_VERTICES = 65535;
+
+// Smallest index type that can address vertexCount vertices
+GLenum indexType(size_t vertexCount);
+size_t indexSize(GLenum type);
+
+// Index data narrowed to the smallest type, ready for glBufferData
+struct IndexBuffer {
+    std::vector<unsigned char> data;
+    GLenum type;
+    size_t count;
+
+    IndexBuffer() : type(GL_UNSIGNED_INT), count(0) {}
+    IndexBuffer(const unsigned *indices, size_t count, size_t vertexCount);
+
+    size_t bytes() const { return this->data.size(); }
+};
+
+// Widens count indices of the given type back to 32 bits
+void unpackIndices(const void *data, GLenum type, size_t count, unsigned *out);
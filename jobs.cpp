@@ -0,0 +1,241 @@
+#include "jobs.h"
+
+#include <chrono>
+
+using namespace std;
+
+static thread_local int workerIndex = -1;
+
+// Deque
+
+JobDeque::JobDeque() : top(0), bottom(0) {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+        this->buffer[i].store(NULL, memory_order_relaxed);
+    }
+}
+
+bool JobDeque::push(Job *job) {
+    long b = this->bottom.load(memory_order_relaxed);
+    long t = this->top.load(memory_order_acquire);
+    if (b - t >= (long)CAPACITY) {
+        return false;
+    }
+
+    this->buffer[b & (CAPACITY - 1)].store(job, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    this->bottom.store(b + 1, memory_order_relaxed);
+    return true;
+}
+
+Job *JobDeque::pop() {
+    long b = this->bottom.load(memory_order_relaxed) - 1;
+    this->bottom.store(b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = this->top.load(memory_order_relaxed);
+
+    if (t > b) {
+        // Empty
+        this->bottom.store(b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    Job *job = this->buffer[b & (CAPACITY - 1)].load(memory_order_relaxed);
+    if (t == b) {
+        // Last item: race against thieves
+        if (!this->top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            job = NULL;
+        }
+        this->bottom.store(b + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+Job *JobDeque::steal() {
+    long t = this->top.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = this->bottom.load(memory_order_acquire);
+
+    if (t >= b) {
+        return NULL;
+    }
+
+    Job *job = this->buffer[t & (CAPACITY - 1)].load(memory_order_relaxed);
+    if (!this->top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return job;
+}
+
+// Job system
+
+JobSystem::JobSystem(unsigned workers) : quit(false), sleeping(0) {
+    if (workers == 0) {
+        workers = 1;
+    }
+
+    for (unsigned i = 0; i < workers; ++i) {
+        this->deques.push_back(new JobDeque);
+    }
+
+    workerIndex = 0;
+    for (unsigned i = 1; i < workers; ++i) {
+        this->threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    this->quit = true;
+    {
+        lock_guard<mutex> lock(this->sleepMutex);
+        this->wake.notify_all();
+    }
+    for (auto &thread : this->threads) {
+        thread.join();
+    }
+    for (auto *deque : this->deques) {
+        delete deque;
+    }
+    workerIndex = -1;
+}
+
+void JobSystem::run(function<void()> task, JobCounter *counter, JobCounter *dependency) {
+    Job *job = new Job;
+    job->task = move(task);
+    job->counter = counter;
+
+    if (counter) {
+        counter->pending.fetch_add(1, memory_order_relaxed);
+    }
+
+    if (dependency) {
+        unique_lock<mutex> lock(dependency->waitingMutex);
+        if (!dependency->done()) {
+            dependency->waiting.push_back(job);
+            return;
+        }
+    }
+
+    this->submit(job);
+}
+
+void JobSystem::submit(Job *job) {
+    // Only the main thread and workers own a deque; anything else runs inline
+    if (workerIndex < 0 || (unsigned)workerIndex >= this->deques.size()
+            || !this->deques[workerIndex]->push(job)) {
+        this->execute(job);
+        return;
+    }
+
+    if (this->sleeping.load(memory_order_relaxed) > 0) {
+        this->wake.notify_one();
+    }
+}
+
+void JobSystem::execute(Job *job) {
+    job->task();
+
+    JobCounter *counter = job->counter;
+    delete job;
+
+    if (!counter) {
+        return;
+    }
+
+    // Not the last job: nobody can be done with the counter yet
+    int pending = counter->pending.load(memory_order_relaxed);
+    while (pending > 1 && !counter->pending.compare_exchange_weak(pending, pending - 1,
+            memory_order_acq_rel, memory_order_relaxed)) {
+    }
+    if (pending > 1) {
+        return;
+    }
+
+    // Maybe the last: drop to zero under the lock, which wait() takes before
+    // returning, so the counter outlives its use here. Jobs waiting for it are released.
+    vector<Job*> ready;
+    {
+        lock_guard<mutex> lock(counter->waitingMutex);
+        if (counter->pending.fetch_sub(1, memory_order_acq_rel) == 1) {
+            ready.swap(counter->waiting);
+        }
+    }
+    for (Job *next : ready) {
+        this->submit(next);
+    }
+}
+
+Job *JobSystem::find(unsigned self) {
+    Job *job = this->deques[self]->pop();
+    if (job) {
+        return job;
+    }
+
+    unsigned n = this->deques.size();
+    for (unsigned i = 1; i < n; ++i) {
+        job = this->deques[(self + i) % n]->steal();
+        if (job) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+void JobSystem::wait(JobCounter *counter) {
+    unsigned self = workerIndex < 0 ? 0 : workerIndex;
+    while (!counter->done()) {
+        Job *job = workerIndex < 0 ? NULL : this->find(self);
+        if (job) {
+            this->execute(job);
+        } else {
+            this_thread::yield();
+        }
+    }
+
+    // The job that finished it may still hold the lock
+    lock_guard<mutex> lock(counter->waitingMutex);
+}
+
+void JobSystem::workerLoop(unsigned index) {
+    workerIndex = index;
+
+    int idle = 0;
+    while (!this->quit.load(memory_order_relaxed)) {
+        Job *job = this->find(index);
+        if (job) {
+            this->execute(job);
+            idle = 0;
+            continue;
+        }
+
+        // Spin a little before going to sleep
+        if (++idle < 64) {
+            this_thread::yield();
+            continue;
+        }
+
+        unique_lock<mutex> lock(this->sleepMutex);
+        ++this->sleeping;
+        this->wake.wait_for(lock, chrono::milliseconds(1));
+        --this->sleeping;
+    }
+}
+
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grain,
+        const function<void(size_t, size_t)> &body,
+        JobCounter *counter, JobCounter *dependency) {
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    JobCounter local;
+    JobCounter *c = counter ? counter : &local;
+
+    for (size_t from = begin; from < end; from += grain) {
+        size_t to = min(from + grain, end);
+        this->run([body, from, to]() { body(from, to); }, c, dependency);
+    }
+
+    if (!counter) {
+        this->wait(c);
+    }
+}
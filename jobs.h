@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+
+// Number of unfinished jobs. Jobs may be scheduled to start only
+// once some counter drops to zero.
+struct JobCounter {
+    std::atomic<int> pending;
+
+    std::mutex waitingMutex;
+    std::vector<Job*> waiting;
+
+    JobCounter() : pending(0) {}
+
+    bool done() const { return this->pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job {
+    std::function<void()> task;
+    JobCounter *counter;
+};
+
+// Chase-Lev work-stealing deque. The owner thread pushes and pops at
+// the bottom, any other thread steals from the top.
+struct JobDeque {
+    static const size_t CAPACITY = 4096;
+
+    std::atomic<long> top;
+    std::atomic<long> bottom;
+    std::atomic<Job*> buffer[CAPACITY];
+
+    JobDeque();
+
+    bool push(Job *job);
+    Job *pop();
+    Job *steal();
+};
+
+struct JobSystem {
+    std::vector<std::thread> threads;
+    std::vector<JobDeque*> deques;
+
+    std::atomic<bool> quit;
+    std::atomic<int> sleeping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    // Spawns `workers` threads; the calling thread becomes worker 0 and
+    // helps out while waiting on counters.
+    JobSystem(unsigned workers = std::thread::hardware_concurrency());
+    ~JobSystem();
+
+    unsigned size() const { return this->deques.size(); }
+
+    // Schedules task. Counter is incremented now and decremented when the task
+    // is finished. If dependency is given, the task starts only after it is done.
+    void run(std::function<void()> task, JobCounter *counter = NULL, JobCounter *dependency = NULL);
+
+    // Runs other jobs until counter reaches zero; counter may be destroyed once it returns
+    void wait(JobCounter *counter);
+
+    // Calls body(from, to) for subranges of [begin, end) of at most grain items.
+    // Blocks if counter is NULL.
+    void parallelFor(size_t begin, size_t end, size_t grain,
+            const std::function<void(size_t, size_t)> &body,
+            JobCounter *counter = NULL, JobCounter *dependency = NULL);
+
+    // Internal
+    void submit(Job *job);
+    void execute(Job *job);
+    Job *find(unsigned self);
+    void workerLoop(unsigned index);
+};
@@ -0,0 +1,60 @@
+#version 430 core
+
+// One invocation per cluster: lists the lights whose sphere touches the
+// cluster's view space box. The work group shares each batch of lights.
+
+layout (local_size_x = 64) in;
+
+const uvec3 GRID = uvec3(16u, 9u, 24u);  // LightGrid::TILES_X, TILES_Y, SLICES
+const uint MAX_CLUSTER_LIGHTS = 256u;
+
+layout (std430, binding = 0) readonly buffer Lights { vec4 lights[]; };  // Position & radius, color & intensity
+layout (std430, binding = 1) writeonly buffer Grid { uvec2 grid[]; };     // Offset & count per cluster
+layout (std430, binding = 2) writeonly buffer Indices { uint indices[]; };
+
+uniform mat4 view;
+uniform vec2 tanHalf;     // View space x & y per unit of depth at the frustum's edge
+uniform vec2 depthRange;  // Near & far
+uniform uint lightCount;
+
+shared vec4 batch[64];  // View space position & radius
+
+void main() {
+    uint c = gl_GlobalInvocationID.x;
+    bool active = c < GRID.x * GRID.y * GRID.z;  // Spare invocations still help load lights
+    uvec3 cell = uvec3(c % GRID.x, c / GRID.x % GRID.y, c / (GRID.x * GRID.y));
+
+    // Box around the frustum cell, exponential slices in depth
+    float depthNear = depthRange.x * pow(depthRange.y / depthRange.x, float(cell.z) / float(GRID.z));
+    float depthFar = depthRange.x * pow(depthRange.y / depthRange.x, float(cell.z + 1u) / float(GRID.z));
+    vec2 lo = (vec2(cell.xy) / vec2(GRID.xy) * 2.0 - 1.0) * tanHalf;
+    vec2 hi = (vec2(cell.xy + 1u) / vec2(GRID.xy) * 2.0 - 1.0) * tanHalf;
+    vec3 boxMin = vec3(min(lo * depthNear, lo * depthFar), -depthFar);
+    vec3 boxMax = vec3(max(hi * depthNear, hi * depthFar), -depthNear);
+
+    uint first = c * MAX_CLUSTER_LIGHTS;
+    uint count = 0u;
+    for (uint base = 0u; base < lightCount; base += 64u) {
+        uint i = base + gl_LocalInvocationIndex;
+        if (i < lightCount) {
+            vec4 light = lights[2u * i];
+            batch[gl_LocalInvocationIndex] = vec4((view * vec4(light.xyz, 1.0)).xyz, light.w);
+        }
+        barrier();
+
+        uint n = min(64u, lightCount - base);
+        for (uint k = 0u; k < n; ++k) {
+            vec4 light = batch[k];
+            vec3 d = max(max(boxMin - light.xyz, light.xyz - boxMax), 0.0);
+            if (active && dot(d, d) <= light.w * light.w && count < MAX_CLUSTER_LIGHTS) {
+                indices[first + count] = base + k;
+                ++count;
+            }
+        }
+        barrier();
+    }
+
+    if (active) {
+        grid[c] = uvec2(first, count);
+    }
+}
@@ -0,0 +1,40 @@
+#version 330 core
+
+// Adds one point light to the pixels its volume covers
+
+#include "lighting.glsl"
+#include "octahedral.glsl"
+
+flat in vec4 lightPosition;
+flat in vec4 lightColor;
+
+uniform sampler2D albedoRoughness;
+uniform sampler2D octNormal;
+uniform sampler2D depth;
+uniform mat4 inverseViewProjection;
+uniform vec3 eye;
+
+out vec4 fragColor;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float z = texelFetch(depth, texel, 0).r;
+    if (z == 1.0) {
+        discard;
+    }
+
+    // World position back from depth
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(depth, 0));
+    vec4 p = inverseViewProjection * vec4(vec3(uv, z) * 2.0 - 1.0, 1.0);
+    vec3 position = p.xyz / p.w;
+
+    vec3 l = lightPosition.xyz - position;
+    if (dot(l, l) >= lightPosition.w * lightPosition.w) {
+        discard;
+    }
+
+    vec4 material = texelFetch(albedoRoughness, texel, 0);
+    vec3 n = octDecode(texelFetch(octNormal, texel, 0).rg);
+    fragColor = vec4(pointLight(position, n, normalize(eye - position), material.rgb, material.a,
+            lightPosition, lightColor), 0.0);
+}
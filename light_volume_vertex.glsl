@@ -0,0 +1,18 @@
+#version 330 core
+
+// Cube around a point light's sphere, one instance per light
+
+layout (location = 0) in vec3 pos;    // Corner of the unit cube
+layout (location = 1) in vec4 light;  // Position & radius
+layout (location = 2) in vec4 color;  // Color & intensity
+
+uniform mat4 viewProjection;
+
+flat out vec4 lightPosition;
+flat out vec4 lightColor;
+
+void main() {
+    lightPosition = light;
+    lightColor = color;
+    gl_Position = viewProjection * vec4(light.xyz + pos * light.w, 1.0);
+}
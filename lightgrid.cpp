@@ -0,0 +1,261 @@
+#include "lightgrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+using namespace std;
+
+const int LightGrid::TILES_X;
+const int LightGrid::TILES_Y;
+const int LightGrid::SLICES;
+const int LightGrid::CLUSTERS;
+const int LightGrid::MAX_CLUSTER_LIGHTS;
+
+// Clusters tested per job
+static const size_t CLUSTER_CHUNK = 64;
+
+static bool hasAvx() {
+    static bool avx = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") != 0;
+    }();
+    return avx;
+}
+
+LightGrid::LightGrid(bool gpu)
+        : gridBuffer(BufferHandle::create()), gridTexture(TextureHandle::create()),
+          indexBuffer(BufferHandle::create()), indexTexture(TextureHandle::create()),
+          assignProgram(NULL), near(0.f), far(0.f), tanHalfX(0.f), tanHalfY(0.f) {
+    if (gpu) {
+        this->assignProgram = new ShaderProgram("light_assign.glsl");
+
+        // Fixed slots per cluster, written in place by the compute shader
+        glBindBuffer(GL_TEXTURE_BUFFER, this->gridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, CLUSTERS * 2 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_TEXTURE_BUFFER, this->indexBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, CLUSTERS * MAX_CLUSTER_LIGHTS * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    } else {
+        this->slots.resize(CLUSTERS * MAX_CLUSTER_LIGHTS);
+        this->grid.resize(CLUSTERS * 2);
+    }
+
+    glBindTexture(GL_TEXTURE_BUFFER, this->gridTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, this->gridBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, this->indexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, this->indexBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+LightGrid::~LightGrid() {
+    delete this->assignProgram;
+}
+
+void LightGrid::buildClusters(const float *projection, float near, float far) {
+    // View space x = ndc.x * depth * tanHalfX, likewise y
+    float tanHalfX = 1.f / projection[0];
+    float tanHalfY = 1.f / projection[5];
+    if (near == this->near && far == this->far && tanHalfX == this->tanHalfX && tanHalfY == this->tanHalfY) {
+        return;
+    }
+    this->near = near;
+    this->far = far;
+    this->tanHalfX = tanHalfX;
+    this->tanHalfY = tanHalfY;
+
+    if (this->assignProgram) {
+        return;
+    }
+
+    this->minX.resize(CLUSTERS);
+    this->minY.resize(CLUSTERS);
+    this->minZ.resize(CLUSTERS);
+    this->maxX.resize(CLUSTERS);
+    this->maxY.resize(CLUSTERS);
+    this->maxZ.resize(CLUSTERS);
+    for (int z = 0; z < SLICES; ++z) {
+        float depthNear = near * powf(far / near, float(z) / SLICES);
+        float depthFar = near * powf(far / near, float(z + 1) / SLICES);
+        for (int y = 0; y < TILES_Y; ++y) {
+            float y0 = (2.f * y / TILES_Y - 1.f) * tanHalfY;
+            float y1 = (2.f * (y + 1) / TILES_Y - 1.f) * tanHalfY;
+            for (int x = 0; x < TILES_X; ++x) {
+                float x0 = (2.f * x / TILES_X - 1.f) * tanHalfX;
+                float x1 = (2.f * (x + 1) / TILES_X - 1.f) * tanHalfX;
+
+                // Box around the frustum cell; its sides are linear in depth
+                int c = (z * TILES_Y + y) * TILES_X + x;
+                this->minX[c] = min(x0 * depthNear, x0 * depthFar);
+                this->maxX[c] = max(x1 * depthNear, x1 * depthFar);
+                this->minY[c] = min(y0 * depthNear, y0 * depthFar);
+                this->maxY[c] = max(y1 * depthNear, y1 * depthFar);
+                this->minZ[c] = -depthFar;
+                this->maxZ[c] = -depthNear;
+            }
+        }
+    }
+}
+
+// Binned lights [begin, end) touching cluster c into its slots after the
+// count already there, returns the new count
+static int assignScalar(const LightGrid &g, int c, size_t begin, size_t end, uint32_t *slots, int count) {
+    for (size_t i = begin; i < end && count < LightGrid::MAX_CLUSTER_LIGHTS; ++i) {
+        float dx = max(max(g.minX[c] - g.lightX[i], g.lightX[i] - g.maxX[c]), 0.f);
+        float dy = max(max(g.minY[c] - g.lightY[i], g.lightY[i] - g.maxY[c]), 0.f);
+        float dz = max(max(g.minZ[c] - g.lightZ[i], g.lightZ[i] - g.maxZ[c]), 0.f);
+        if (dx * dx + dy * dy + dz * dz <= g.lightRadius[i] * g.lightRadius[i]) {
+            slots[count++] = g.lightIndex[i];
+        }
+    }
+    return count;
+}
+
+__attribute__((target("avx")))
+static int assignAvx(const LightGrid &g, int c, size_t begin, size_t end, uint32_t *slots) {
+    __m256 lo[3] = { _mm256_set1_ps(g.minX[c]), _mm256_set1_ps(g.minY[c]), _mm256_set1_ps(g.minZ[c]) };
+    __m256 hi[3] = { _mm256_set1_ps(g.maxX[c]), _mm256_set1_ps(g.maxY[c]), _mm256_set1_ps(g.maxZ[c]) };
+    const float *centers[3] = { g.lightX.data(), g.lightY.data(), g.lightZ.data() };
+    const float *radius = g.lightRadius.data();
+    const uint32_t *index = g.lightIndex.data();
+    __m256 zero = _mm256_setzero_ps();
+
+    int n = 0;
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        // Squared distance from the light to the box
+        __m256 d2 = zero;
+        for (int k = 0; k < 3; ++k) {
+            __m256 p = _mm256_loadu_ps(centers[k] + i);
+            __m256 d = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(lo[k], p), _mm256_sub_ps(p, hi[k])), zero);
+            d2 = _mm256_add_ps(d2, _mm256_mul_ps(d, d));
+        }
+        __m256 r = _mm256_loadu_ps(radius + i);
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(r, r), _CMP_LE_OQ));
+        while (mask) {
+            if (n == LightGrid::MAX_CLUSTER_LIGHTS) {
+                return n;
+            }
+            slots[n++] = index[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+    }
+    return assignScalar(g, c, i, end, slots, n);
+}
+
+void LightGrid::assignCpu(const LightBuffer &lights, const float *view, JobSystem &jobs) {
+    // Lights to view space, with the range of depth slices each reaches
+    size_t count = lights.count;
+    vector<float> x(count), y(count), z(count);
+    vector<int> firstSlice(count), lastSlice(count);
+    this->sliceFirst.assign(SLICES + 1, 0);
+    float slicesPerLog = SLICES / logf(this->far / this->near);
+    for (size_t i = 0; i < count; ++i) {
+        const float *p = lights.lights[i].position;
+        float r = lights.lights[i].radius;
+        x[i] = view[0] * p[0] + view[4] * p[1] + view[8] * p[2] + view[12];
+        y[i] = view[1] * p[0] + view[5] * p[1] + view[9] * p[2] + view[13];
+        z[i] = view[2] * p[0] + view[6] * p[1] + view[10] * p[2] + view[14];
+
+        float depthNear = -z[i] - r;
+        float depthFar = -z[i] + r;
+        if (depthFar < this->near || depthNear > this->far) {
+            firstSlice[i] = 0;
+            lastSlice[i] = -1;
+            continue;
+        }
+        firstSlice[i] = depthNear <= this->near ? 0 : min(int(logf(depthNear / this->near) * slicesPerLog), SLICES - 1);
+        lastSlice[i] = depthFar >= this->far ? SLICES - 1 : min(int(logf(depthFar / this->near) * slicesPerLog), SLICES - 1);
+        for (int s = firstSlice[i]; s <= lastSlice[i]; ++s) {
+            ++this->sliceFirst[s + 1];
+        }
+    }
+    for (int s = 0; s < SLICES; ++s) {
+        this->sliceFirst[s + 1] += this->sliceFirst[s];
+    }
+
+    // Binned by slice, so a cluster only tests the lights of its own
+    size_t binned = this->sliceFirst[SLICES];
+    this->lightX.resize(binned);
+    this->lightY.resize(binned);
+    this->lightZ.resize(binned);
+    this->lightRadius.resize(binned);
+    this->lightIndex.resize(binned);
+    vector<uint32_t> next(this->sliceFirst.begin(), this->sliceFirst.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        for (int s = firstSlice[i]; s <= lastSlice[i]; ++s) {
+            uint32_t k = next[s]++;
+            this->lightX[k] = x[i];
+            this->lightY[k] = y[i];
+            this->lightZ[k] = z[i];
+            this->lightRadius[k] = lights.lights[i].radius;
+            this->lightIndex[k] = i;
+        }
+    }
+
+    bool avx = hasAvx();
+    jobs.parallelFor(0, CLUSTERS, CLUSTER_CHUNK, [&](size_t from, size_t to) {
+        for (size_t c = from; c < to; ++c) {
+            int s = c / (TILES_X * TILES_Y);
+            uint32_t begin = this->sliceFirst[s];
+            uint32_t end = this->sliceFirst[s + 1];
+            uint32_t *slots = &this->slots[c * MAX_CLUSTER_LIGHTS];
+            this->grid[c * 2 + 1] = avx ? assignAvx(*this, c, begin, end, slots)
+                                        : assignScalar(*this, c, begin, end, slots, 0);
+        }
+    });
+
+    // Compact the lists back to back
+    this->indices.clear();
+    for (int c = 0; c < CLUSTERS; ++c) {
+        uint32_t n = this->grid[c * 2 + 1];
+        this->grid[c * 2] = this->indices.size();
+        this->indices.insert(this->indices.end(), &this->slots[c * MAX_CLUSTER_LIGHTS],
+                &this->slots[c * MAX_CLUSTER_LIGHTS] + n);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, this->gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, this->grid.size() * sizeof(uint32_t), this->grid.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, this->indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, max<size_t>(this->indices.size(), 1) * sizeof(uint32_t), this->indices.data(),
+            GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightGrid::assign(const LightBuffer &lights, const float *view, const float *projection, float near, float far,
+        JobSystem &jobs) {
+    this->buildClusters(projection, near, far);
+    if (!this->assignProgram) {
+        this->assignCpu(lights, view, jobs);
+        return;
+    }
+
+    this->assignProgram->use();
+    this->assignProgram->setMatrix4fv("view", 1, view);
+    this->assignProgram->set2f("tanHalf", this->tanHalfX, this->tanHalfY);
+    this->assignProgram->set2f("depthRange", this->near, this->far);
+    this->assignProgram->set1ui("lightCount", lights.count);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lights.buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->gridBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->indexBuffer);
+    glDispatchCompute((CLUSTERS + 63) / 64, 1, 1);
+
+    // Lists are read through buffer textures
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void LightGrid::bind(ShaderProgram &program, int gridUnit, int indexUnit, int width, int height) {
+    glActiveTexture(GL_TEXTURE0 + gridUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, this->gridTexture);
+    glActiveTexture(GL_TEXTURE0 + indexUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, this->indexTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    program.set1i("lightGrid", gridUnit);
+    program.set1i("lightIndices", indexUnit);
+    program.set2f("viewportSize", width, height);
+    program.set2f("depthRange", this->near, this->far);
+}
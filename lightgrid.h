@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "context.h"
+#include "deferred.h"
+#include "glhandle.h"
+#include "jobs.h"
+#include "shader.h"
+
+// Clustered light assignment. The view frustum is split into screen tiles
+// and exponential depth slices; each cluster gets the list of lights whose
+// sphere touches its view space bounding box, so a fragment only loops over
+// the lights near it.
+//
+// Lists are built by a compute shader when OpenGL 4.3 is available, else
+// on the job system with AVX. Either way the fragment shader reads them
+// from buffer textures: grid (RG32UI offset & count per cluster) and
+// indices (R32UI light index).
+struct LightGrid {
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int CLUSTERS = TILES_X * TILES_Y * SLICES;
+    static const int MAX_CLUSTER_LIGHTS = 256;  // Further lights in a cluster are dropped
+
+    BufferHandle gridBuffer;
+    TextureHandle gridTexture;
+    BufferHandle indexBuffer;
+    TextureHandle indexTexture;
+
+    ShaderProgram *assignProgram;  // NULL when assigning on the CPU
+
+    // Frustum the clusters were built for
+    float near;
+    float far;
+    float tanHalfX;
+    float tanHalfY;
+
+    // CPU assignment: cluster bounds, and lights in view space binned by the
+    // depth slices they reach, structure of arrays
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<float> lightX, lightY, lightZ, lightRadius;
+    std::vector<uint32_t> lightIndex;  // Into the LightBuffer
+    std::vector<uint32_t> sliceFirst;  // First binned light per slice, then the total
+    std::vector<uint32_t> slots;   // MAX_CLUSTER_LIGHTS per cluster
+    std::vector<uint32_t> grid;    // Offset & count per cluster
+    std::vector<uint32_t> indices;
+
+    LightGrid(bool gpu);
+    ~LightGrid();
+
+    // Assigns lights for a camera at view with projection perspective(fovy, aspect, near, far)
+    void assign(const LightBuffer &lights, const float *view, const float *projection, float near, float far,
+            JobSystem &jobs);
+
+    // Grid & indices to the given texture units, with the uniforms clustered.glsl needs
+    void bind(ShaderProgram &program, int gridUnit, int indexUnit, int width, int height);
+
+    // Internal
+    void buildClusters(const float *projection, float near, float far);
+    void assignCpu(const LightBuffer &lights, const float *view, JobSystem &jobs);
+};
@@ -0,0 +1,42 @@
+// Lighting shared by the forward, clustered & deferred shaders, included after #version
+
+uniform sampler2DShadow shadowAtlas;
+uniform mat4 shadowMatrices[4];  // World to atlas coordinates & depth per cascade
+uniform vec4 cascadeEnds;        // View depth each cascade reaches
+uniform vec4 cascadeTexels;      // World size of a shadow texel per cascade
+uniform vec4 depthPlane;         // View depth of p is dot(depthPlane, vec4(p, 1))
+
+const vec3 AMBIENT = vec3(0.03);
+const vec3 SUN_DIRECTION = vec3(0.267, 0.802, -0.535);  // Towards the sun
+const vec3 SUN_COLOR = vec3(0.2);
+
+// Sun visibility at p: the covering cascade, offset along the normal, 2x2 filtered taps
+float sunShadow(vec3 p, vec3 n) {
+    float viewDepth = dot(depthPlane, vec4(p, 1.0));
+    if (viewDepth > cascadeEnds[3]) {
+        return 1.0;
+    }
+    int c = 0;
+    while (viewDepth > cascadeEnds[c]) {
+        ++c;
+    }
+    vec3 s = (shadowMatrices[c] * vec4(p + n * cascadeTexels[c] * 1.5, 1.0)).xyz;
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    return 0.25 * (texture(shadowAtlas, vec3(s.xy + vec2(-0.5, -0.5) * texel, s.z))
+                 + texture(shadowAtlas, vec3(s.xy + vec2( 0.5, -0.5) * texel, s.z))
+                 + texture(shadowAtlas, vec3(s.xy + vec2(-0.5,  0.5) * texel, s.z))
+                 + texture(shadowAtlas, vec3(s.xy + vec2( 0.5,  0.5) * texel, s.z)));
+}
+
+// Blinn-Phong with windowed inverse square falloff, reaching zero at radius
+vec3 pointLight(vec3 p, vec3 n, vec3 v, vec3 albedo, float roughness, vec4 light, vec4 color) {
+    vec3 l = light.xyz - p;
+    float d2 = dot(l, l);
+    float window = clamp(1.0 - d2 * d2 / (light.w * light.w * light.w * light.w), 0.0, 1.0);
+    float attenuation = window * window / (d2 + 1.0);
+    l *= inversesqrt(d2);
+
+    float shininess = 2.0 / max(roughness * roughness * roughness * roughness, 1e-4) - 2.0;
+    float specular = pow(max(dot(n, normalize(l + v)), 0.0), shininess) * (shininess + 8.0) / 25.13;
+    return (albedo + vec3(specular * 0.04)) * color.rgb * color.a * max(dot(n, l), 0.0) * attenuation;
+}
@@ -1,163 +1,171 @@
-#define GL_GLEXT_PROTOTYPES
-
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_opengl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <string>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "bvh.h"
+#include "capture.h"
+#include "clustercull.h"
+#include "context.h"
+#include "culling.h"
+#include "deferred.h"
+#include "dynres.h"
+#include "framebuffer.h"
+#include "framepacing.h"
+#include "fxaa.h"
+#include "glhandle.h"
+#include "gputimer.h"
+#include "hiz.h"
+#include "indexbuffer.h"
+#include "jobs.h"
+#include "lightgrid.h"
+#include "mesh.h"
+#include "meshcache.h"
+#include "meshloader.h"
+#include "meshopt.h"
+#include "meshpool.h"
+#include "occlusion.h"
+#include "options.h"
+#include "scene.h"
+#include "shader.h"
+#include "shadow.h"
+#include "simplify.h"
+#include "texture.h"
+#include "timestep.h"
+#include "transform.h"
+#include "vertexformat.h"
+
 using namespace std;
 using namespace glm;
 
 SDL_Window *win;
 SDL_GLContext cont;
 
-struct Shader {
-    GLuint shader;
-    GLenum type;
-    GLchar *source;
+// Objects are laid out in a OBJECTS_SIDE^3 grid
+const int OBJECTS_SIDE = 16;
+const int OBJECTS = OBJECTS_SIDE * OBJECTS_SIDE * OBJECTS_SIDE;
+const float OBJECTS_SPACING = 2.f;
 
-    Shader(const GLenum type, const char* path) {
-        // Create shader
-        this->type = type;
-        this->shader = glCreateShader(this->type);
-        
-        // Load source
-        FILE *file = NULL;
-        file = fopen(path, "r");
-        if (file == NULL) {
-            cerr << "ERROR::SHADER::" << (this->type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT") << "::SOURCE_FILE_CANNOT_BE_OPENED" << endl;
+// Simulation runs at a fixed rate, rendering interpolates between its steps
+const double SIMULATION_STEP = 1.0 / 60.0;
+const float SPIN_SPEED = 2.f;  // Radians per second
+const float TWO_PI = 2.f * float(M_PI);
 
-            SDL_GL_DeleteContext(cont);
-            SDL_DestroyWindow(win);
-            SDL_Quit();
-            exit(1);
-        }
+// Towards the sun, as in the shaders
+const float SUN_DIRECTION[3] = { 0.267f, 0.802f, -0.535f };
 
-        fseek(file, 0L, SEEK_END);
-        long int size = ftell(file) + 1;
-        rewind(file);
+// Longest sleep in idle mode, so deferred work still gets collected
+const int IDLE_TIMEOUT_MS = 500;
 
-        this->source = (GLchar*) malloc(size * sizeof(GLchar));
-        for (int i = 0; i < size; ++i) {
-            this->source[i] = fgetc(file);
-        }
-        this->source[size - 1] = '\0';
+// Camera depth range
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.f;
 
-        fclose(file);
+// Visible objects are transformed in chunks of this size
+const size_t OBJECTS_CHUNK = 1024;
 
-        // Compile
-        glShaderSource(*this, 1, (const GLchar**)&(this->source), NULL);
-        glCompileShader(*this);
+// Nearest objects rasterized by the CPU occlusion culler
+const size_t OCCLUDERS = 64;
 
-        int success;
-        glGetShaderiv(*this, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            char infoLog[1024];
-            glGetShaderInfoLog(*this, sizeof(infoLog)/sizeof(infoLog[0]), NULL, infoLog);
-            cerr << "ERROR::SHADER::" << (this->type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT") << "::COMPILATION_FAILED\n" << infoLog << endl;
+// Meshlet draws per frame after cluster culling
+const size_t CLUSTER_COMMANDS = 1 << 20;
 
-            SDL_GL_DeleteContext(cont);
-            SDL_DestroyWindow(win);
-            SDL_Quit();
-            exit(1);
+// Angle in [0, 2 pi), so a long run doesn't wear away float precision
+static float wrapAngle(float angle) {
+    angle = fmod(angle, TWO_PI);
+    return angle < 0.f ? angle + TWO_PI : angle;
+}
+
+// Scales & centers mesh into the unit cube the scene's bounds assume
+static void fitUnitCube(Mesh &mesh) {
+    float lo[3] = { 1e30f, 1e30f, 1e30f };
+    float hi[3] = { -1e30f, -1e30f, -1e30f };
+    for (size_t v = 0; v < mesh.vertexCount(); ++v) {
+        const float *p = mesh.position(v);
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
         }
     }
-
-    operator GLuint() const { return this->shader; }
-
-    ~Shader() {
-        free((void*)(this->source));
-        glDeleteShader(*this);
+    float size = 1e-6f;
+    for (int k = 0; k < 3; ++k) {
+        size = std::max(size, hi[k] - lo[k]);
     }
-};
-
-struct ShaderProgram {
-    GLuint program;
-
-    ShaderProgram(const char *vertexShaderPath, const char *fragmentShaderPath) {
-        // Create program
-        this->program = glCreateProgram();
-
-        // Create shaders
-        Shader *vertexShader = new Shader(GL_VERTEX_SHADER, vertexShaderPath);
-        Shader *fragmentShader = new Shader(GL_FRAGMENT_SHADER, fragmentShaderPath);
-
-        // Attach Shaders
-        glAttachShader(*this, *vertexShader);
-        glAttachShader(*this, *fragmentShader);
-
-        // Link
-        glLinkProgram(*this);
-
-        int success;
-        glGetProgramiv(*this, GL_LINK_STATUS, &success);
-        if (!success) {
-            char infoLog[1024];
-            glGetProgramInfoLog(*this, sizeof(infoLog)/sizeof(infoLog[0]), NULL, infoLog);
-            cout << "ERROR::SHADER_PROGRAM::LINKING_FAILED\n" << infoLog << endl;
-
-            SDL_GL_DeleteContext(cont);
-            SDL_DestroyWindow(win);
-            SDL_Quit();
-            exit(1);
+    for (size_t v = 0; v < mesh.vertexCount(); ++v) {
+        float *p = &mesh.vertices[v * mesh.stride];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = (p[k] - (lo[k] + hi[k]) * 0.5f) / size;
         }
-
-        delete vertexShader;
-        delete fragmentShader;
     }
+}
 
-    operator GLuint() const { return this->program; }
-
-    void use() { glUseProgram(*this); }
-
-    void set1i(const char *name, const GLint val) { glUniform1i(glGetUniformLocation(*this, name), val); }
-    void setMatrix4fv(const char *name, const int count, const GLfloat *val) { glUniformMatrix4fv(glGetUniformLocation(*this, name), count, GL_FALSE, val); }
-};
-
-struct Texture {
-    GLuint texture;
-
-    Texture(const char *path, const GLenum format, const GLenum loadformat) {
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Reorders for vertex cache & overdraw, generates lods, then quantizes: unorm16
+// positions relative to bounds, half float texture coordinates, octahedral normals
+static void buildMesh(Mesh &mesh, PackedMesh &packed, JobSystem &jobs) {
+    MeshOptimizeStats meshStats = optimizeMesh(mesh);
+    cout << "Mesh: ACMR " << meshStats.before.acmr << " -> " << meshStats.after.acmr
+         << ", ATVR " << meshStats.before.atvr << " -> " << meshStats.after.atvr << endl;
 
-        int width, height, nrChannels;
-        stbi_set_flip_vertically_on_load(true);
-        unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0); 
-        if (!data) {
-            cout << "ERROR::TEXTURE::IMAGE_CANNOT_BE_LOADED" << endl;
+    vector<MeshLod> lods = generateLods(mesh, jobs);
+    for (size_t l = 0; l < lods.size(); ++l) {
+        cout << "Mesh: lod " << l << ": " << lods[l].indexCount / 3 << " triangles, error " << lods[l].error << endl;
+    }
 
-            SDL_GL_DeleteContext(cont);
-            SDL_DestroyWindow(win);
-            SDL_Quit();
-            exit(1);
+    packed.format.add(0, 3, ATTRIBUTE_UNORM16).add(1, 2, ATTRIBUTE_HALF);
+    if (mesh.stride == LOADED_MESH_STRIDE) {
+        packed.format.add(6, 3, ATTRIBUTE_OCT_SNORM16);
+    }
+    packMesh(mesh, packed, lods);
+    cout << "Mesh: vertex size " << mesh.stride * sizeof(float) << " -> " << packed.format.stride
+         << " bytes, index size " << sizeof(unsigned) << " -> " << indexSize(packed.indices.type) << " bytes" << endl;
+}
 
-            stbi_image_free(data);
-        }
+// Maps path's binary cache, first (re)building it from path if it is missing, stale or corrupt
+static MeshCache *openMeshCache(const char *path, JobSystem &jobs) {
+    string cachePath = string(path) + ".meshcache";
+    MeshCache *cache = new MeshCache(cachePath.c_str());
+    if (cache->isFresh(path)) {
+        return cache;
+    }
+    delete cache;
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, loadformat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+    Mesh mesh;
+    if (!loadMesh(path, mesh, jobs)) {
+        return NULL;
+    }
+    fitUnitCube(mesh);
+    PackedMesh packed;
+    buildMesh(mesh, packed, jobs);
+    if (!writeMeshCache(cachePath.c_str(), packed, path)) {
+        return NULL;
+    }
 
-        stbi_image_free(data);
+    cache = new MeshCache(cachePath.c_str());
+    if (!cache->loaded) {
+        delete cache;
+        return NULL;
     }
+    return cache;
+}
 
-    operator int() const { return texture; }
-};
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
 
-int main() {
     SDL_Init(SDL_INIT_VIDEO);
 
+    JobSystem jobs;
+
+    // Antialiasing happens offscreen; a multisampled window would only add a resolve
+    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 0);
     win = SDL_CreateWindow("",
             SDL_WINDOWPOS_CENTERED,
             SDL_WINDOWPOS_CENTERED,
@@ -165,44 +173,55 @@ int main() {
             SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
     cont = SDL_GL_CreateContext(win);
 
+    SwapMode swapMode = setSwapMode(options.swapMode);
+    cout << "Vsync " << swapModeName(swapMode) << ", frame limit ";
+    if (options.fpsLimit > 0.0) {
+        cout << options.fpsLimit << " fps";
+    } else {
+        cout << "none";
+    }
+    cout << (options.lowLatency ? ", low latency" : "") << (options.idle ? ", idle when static" : "") << endl;
+
     // Setting up opengl
     glEnable(GL_DEPTH_TEST);
 
-    // Setting up shaders
+    // Setting up shaders: lit while drawing, or material & normal into the G-buffer
     ShaderProgram *program = new ShaderProgram("vertex.glsl", "fragment.glsl");
+    ShaderProgram *gbufferProgram = new ShaderProgram("vertex.glsl", "gbuffer.glsl");
+    ShaderProgram *clusteredProgram = new ShaderProgram("vertex.glsl", "clustered.glsl");
 
-    // Setting up vertices, VBO & VAO
+    // Setting up vertices
     const float vert[] = {
-        // Coordinates        // Texture coordinates
-         0.5f,  0.5f, -0.5f,   1.f, 1.f,
-         0.5f, -0.5f, -0.5f,   1.f, 0.f,
-        -0.5f, -0.5f, -0.5f,   0.f, 0.f,
-        -0.5f,  0.5f, -0.5f,   0.f, 1.f,
-
-         0.5f,  0.5f,  0.5f,   1.f, 1.f,
-         0.5f, -0.5f,  0.5f,   1.f, 0.f,
-        -0.5f, -0.5f,  0.5f,   0.f, 0.f,
-        -0.5f,  0.5f,  0.5f,   0.f, 1.f,
-
-         0.5f,  0.5f, -0.5f,   1.f, 1.f,
-         0.5f, -0.5f, -0.5f,   1.f, 0.f,
-         0.5f, -0.5f,  0.5f,   0.f, 0.f,
-         0.5f,  0.5f,  0.5f,   0.f, 1.f,
-
-        -0.5f, -0.5f, -0.5f,   1.f, 1.f,
-        -0.5f,  0.5f, -0.5f,   1.f, 0.f,
-        -0.5f,  0.5f,  0.5f,   0.f, 0.f,
-        -0.5f, -0.5f,  0.5f,   0.f, 1.f,
-
-         0.5f, -0.5f, -0.5f,   1.f, 1.f,
-        -0.5f, -0.5f, -0.5f,   1.f, 0.f,
-        -0.5f, -0.5f,  0.5f,   0.f, 0.f,
-         0.5f, -0.5f,  0.5f,   0.f, 1.f,
-
-         0.5f,  0.5f, -0.5f,   1.f, 1.f,
-        -0.5f,  0.5f, -0.5f,   1.f, 0.f,
-        -0.5f,  0.5f,  0.5f,   0.f, 0.f,
-         0.5f,  0.5f,  0.5f,   0.f, 1.f,
+        // Coordinates        // Texture  // Normal
+         0.5f,  0.5f, -0.5f,   1.f, 1.f,   0.f,  0.f, -1.f,
+         0.5f, -0.5f, -0.5f,   1.f, 0.f,   0.f,  0.f, -1.f,
+        -0.5f, -0.5f, -0.5f,   0.f, 0.f,   0.f,  0.f, -1.f,
+        -0.5f,  0.5f, -0.5f,   0.f, 1.f,   0.f,  0.f, -1.f,
+
+         0.5f,  0.5f,  0.5f,   1.f, 1.f,   0.f,  0.f,  1.f,
+         0.5f, -0.5f,  0.5f,   1.f, 0.f,   0.f,  0.f,  1.f,
+        -0.5f, -0.5f,  0.5f,   0.f, 0.f,   0.f,  0.f,  1.f,
+        -0.5f,  0.5f,  0.5f,   0.f, 1.f,   0.f,  0.f,  1.f,
+
+         0.5f,  0.5f, -0.5f,   1.f, 1.f,   1.f,  0.f,  0.f,
+         0.5f, -0.5f, -0.5f,   1.f, 0.f,   1.f,  0.f,  0.f,
+         0.5f, -0.5f,  0.5f,   0.f, 0.f,   1.f,  0.f,  0.f,
+         0.5f,  0.5f,  0.5f,   0.f, 1.f,   1.f,  0.f,  0.f,
+
+        -0.5f, -0.5f, -0.5f,   1.f, 1.f,  -1.f,  0.f,  0.f,
+        -0.5f,  0.5f, -0.5f,   1.f, 0.f,  -1.f,  0.f,  0.f,
+        -0.5f,  0.5f,  0.5f,   0.f, 0.f,  -1.f,  0.f,  0.f,
+        -0.5f, -0.5f,  0.5f,   0.f, 1.f,  -1.f,  0.f,  0.f,
+
+         0.5f, -0.5f, -0.5f,   1.f, 1.f,   0.f, -1.f,  0.f,
+        -0.5f, -0.5f, -0.5f,   1.f, 0.f,   0.f, -1.f,  0.f,
+        -0.5f, -0.5f,  0.5f,   0.f, 0.f,   0.f, -1.f,  0.f,
+         0.5f, -0.5f,  0.5f,   0.f, 1.f,   0.f, -1.f,  0.f,
+
+         0.5f,  0.5f, -0.5f,   1.f, 1.f,   0.f,  1.f,  0.f,
+        -0.5f,  0.5f, -0.5f,   1.f, 0.f,   0.f,  1.f,  0.f,
+        -0.5f,  0.5f,  0.5f,   0.f, 0.f,   0.f,  1.f,  0.f,
+         0.5f,  0.5f,  0.5f,   0.f, 1.f,   0.f,  1.f,  0.f,
     };
 
     const unsigned int indices[] = {
@@ -225,77 +244,751 @@ int main() {
         21, 22, 23,
     };
 
-    GLuint VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers     (1, &VBO);
-    glGenBuffers     (1, &EBO);
+    // Occlusion culling on the GPU needs compute shaders,
+    // otherwise a CPU rasterized depth buffer is used
+    bool cpuOcclusion = !HiZ::supported();
+
+    // A mesh file given on the command line replaces the cube. It is drawn
+    // straight from its memory mapped cache; only the CPU occlusion culler
+    // needs anything decoded, the positions & the finest lod.
+    Mesh mesh(LOADED_MESH_STRIDE);
+    MeshCache *cache = options.meshPath ? openMeshCache(options.meshPath, jobs) : NULL;
+    PackedMesh packed;
+    size_t occluderFirstIndex = 0;  // Of the finest lod in mesh.indices
+    if (cache) {
+        packed.format = cache->format;
+        packed.indices.type = cache->header->indexType;
+        packed.indices.count = cache->header->indexCount;
+        packed.vertexCount = cache->header->vertexCount;
+        packed.lods.assign(cache->lods, cache->lods + cache->header->lodCount);
+        packed.meshlets.assign(cache->meshlets, cache->meshlets + cache->header->meshletCount);
+        if (cpuOcclusion) {
+            cache->decode(mesh, packed.lods[0]);
+        }
+        cout << "Loaded " << options.meshPath << ": " << cache->header->vertexCount << " vertices, "
+             << cache->header->indexCount / 3 << " triangles" << endl;
+    } else {
+        mesh.vertices.assign(vert, vert + sizeof(vert)/sizeof(vert[0]));
+        mesh.indices.assign(indices, indices + sizeof(indices)/sizeof(indices[0]));
+        buildMesh(mesh, packed, jobs);
+        occluderFirstIndex = packed.lods[0].firstIndex;
+    }
+
+    program->use();
+    packed.format.setUniforms(*program);
+    gbufferProgram->use();
+    packed.format.setUniforms(*gbufferProgram);
+    clusteredProgram->use();
+    packed.format.setUniforms(*clusteredProgram);
+
+    // Meshes are sub-allocated from shared buffers behind one VAO
+    MeshPool *pool = new MeshPool(packed.format, packed.indices.type, packed.vertexCount, packed.indices.count);
+    int meshId = cache
+        ? pool->add(cache->vertices, packed.vertexCount, cache->indices, packed.indices.type, packed.indices.count)
+        : pool->add(packed.vertices.data(), packed.vertexCount, packed.indices.data.data(), packed.indices.type, packed.indices.count);
+    if (meshId < 0) {
+        SDL_GL_DeleteContext(cont);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+        return 1;
+    }
+    GLuint firstIndex = pool->firstIndex(meshId);
+    GLint baseVertex = pool->baseVertex(meshId);
+    pool->printStats();
+
+    BufferHandle instanceVBO = BufferHandle::create();
+    BufferHandle modelVBO = BufferHandle::create();
+
+    // Instances start at the given model-view-projection in instanceVBO & model in modelVBO
+    auto pointInstances = [&](size_t first) {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        for (int i = 0; i < 4; ++i) {
+            glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(first * sizeof(mat4) + i * sizeof(vec4)));
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
+        for (int i = 0; i < 4; ++i) {
+            glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(first * sizeof(mat4) + i * sizeof(vec4)));
+        }
+    };
+
+    glBindVertexArray(pool->vao);
+        // Per instance model-view-projection & model attribs (one column per location)
+        pointInstances(0);
+        for (int i = 0; i < 4; ++i) {
+            glVertexAttribDivisor(2 + i, 1);
+            glEnableVertexAttribArray(2 + i);
+            glVertexAttribDivisor(7 + i, 1);
+            glEnableVertexAttribArray(7 + i);
+        }
+    glBindVertexArray(0);
 
-    glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    // Uploaded, the mapping is no longer needed
+    delete cache;
+
+    // Setting up objects
+    vector<vec3> positions(OBJECTS);
+    vector<float> spin(OBJECTS);          // Angle of the latest simulation step
+    vector<float> previousSpin(OBJECTS);  // And of the one before
+    vector<char> spinning(OBJECTS);       // Every other object stands still, a static shadow caster
+    vector<mat4> models(OBJECTS);
+    vector<mat4> mvps(OBJECTS);
+    ObjectBounds bounds;
+    bounds.resize(OBJECTS);
+
+    // Objects are children of the scene root, object i is entity 1 + i
+    TransformSystem transforms;
+    transforms.reserve(1 + OBJECTS);
+    uint32_t root = transforms.create();
+    for (int i = 0; i < OBJECTS; ++i) {
+        int x = i % OBJECTS_SIDE;
+        int y = i / OBJECTS_SIDE % OBJECTS_SIDE;
+        int z = i / OBJECTS_SIDE / OBJECTS_SIDE;
+        positions[i] = (vec3(x, y, z) - vec3(OBJECTS_SIDE - 1) / 2.f) * OBJECTS_SPACING;
+        spin[i] = previousSpin[i] = wrapAngle(i * 0.37f);
+        spinning[i] = (x + y + z) % 2;
+        transforms.create(root);
+        transforms.setPosition(1 + i, positions[i].x, positions[i].y, positions[i].z);
+
+        // Cube of side 1 spinning around its center
+        float radius = sqrtf(3.f) / 2.f;
+        bounds.set(i, value_ptr(positions[i]), value_ptr(vec3(radius)), radius);
+    }
 
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vert), vert, GL_STATIC_DRAW);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    // Objects start at their initial angle, which static ones keep
+    const vec3 spinAxis = normalize(vec3(0.5f, 1.f, 0.f));
+    auto setSpin = [&](unsigned i, float angle) {
+        float rotation[4];
+        axisAngleQuaternion(value_ptr(spinAxis), angle, rotation);
+        transforms.setRotation(1 + i, rotation[0], rotation[1], rotation[2], rotation[3]);
+    };
+    for (int i = 0; i < OBJECTS; ++i) {
+        setSpin(i, spin[i]);
+    }
+    transforms.update(jobs, OBJECTS_CHUNK);
+
+    Bvh bvh;
+    bvh.build(bounds);
+
+    // Point lights scattered through the grid of objects
+    const float lightsCenter[3] = { 0.f, 0.f, 0.f };
+    const float lightsExtent[3] = { OBJECTS_SIDE * OBJECTS_SPACING / 2.f, OBJECTS_SIDE * OBJECTS_SPACING / 2.f,
+                                    OBJECTS_SIDE * OBJECTS_SPACING / 2.f };
+    const float LIGHT_RADIUS = 2.f * OBJECTS_SPACING;
+    LightBuffer *lights = new LightBuffer();
+    lights->set(scatterLights(options.lights, lightsCenter, lightsExtent, LIGHT_RADIUS));
+
+    // Deferred shading lights the G-buffer afterwards, forward shading while drawing;
+    // clustered forward shading first lists the lights of each part of the view frustum
+    DeferredRenderer *deferred = new DeferredRenderer();
+    LightGrid *lightGrid = new LightGrid(HiZ::supported());
+    ShadingPath shading = options.shading;
+
+    // MSAA doesn't reach the G-buffer, so the antialiasing benchmark runs forward
+    if (options.aaBenchmark && shading == SHADING_DEFERRED) {
+        shading = SHADING_FORWARD;
+    }
+    cout << "Shading " << shadingPathName(shading) << ", " << lights->count << " lights, clusters assigned on the "
+         << (lightGrid->assignProgram ? "GPU" : "CPU") << endl;
+
+    // Sun shadows; casters drawn at the lod whose error stays within a shadow texel
+    CascadedShadows *shadows = new CascadedShadows(SUN_DIRECTION, options.shadowCache);
+    packed.format.setUniforms(*shadows->program);
+    BufferHandle shadowVBO = BufferHandle::create();
+    vector<unsigned> casters(OBJECTS);
+    vector<unsigned> staticCasters[CascadedShadows::CASCADES];
+    vector<unsigned> dynamicCasters[CascadedShadows::CASCADES];
+    vector<mat4> casterModels(OBJECTS);
+    vector<mat4> casterMvps(OBJECTS);
+    auto drawCasters = [&](const vector<unsigned> &objects, int cascade) {
+        size_t count = objects.size();
+        if (count == 0) {
+            return;
+        }
+        for (size_t k = 0; k < count; ++k) {
+            memcpy(value_ptr(casterModels[k]), transforms.worldMatrix(1 + objects[k]), sizeof(mat4));
+        }
+        mulMat4Batch(shadows->viewProjection[cascade], value_ptr(casterModels[0]), value_ptr(casterMvps[0]), count);
+        glBindBuffer(GL_ARRAY_BUFFER, shadowVBO);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(mat4), casterMvps.data(), GL_STREAM_DRAW);
+        for (int i = 0; i < 4; ++i) {
+            glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(i * sizeof(vec4)));
+        }
+        const MeshLod &lod = packed.lods[shadows->selectLod(cascade, packed.lods)];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount, packed.indices.type,
+                (void*)((firstIndex + lod.firstIndex) * indexSize(packed.indices.type)), count, baseVertex);
+    };
 
-        // Coordinates attrib
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+    // Benchmark: each light count & path is timed over a few seconds of frames
+    const int BENCHMARK_LIGHTS[] = { 10, 100, 1000, 4000 };
+    const int BENCHMARK_RUNS = SHADING_PATHS * sizeof(BENCHMARK_LIGHTS) / sizeof(BENCHMARK_LIGHTS[0]);
+    const int BENCHMARK_WARMUP = 30;
+    const int BENCHMARK_FRAMES = 240;
+    int benchmarkRun = -1;
+    int benchmarkFrame = 0;
+    double benchmarkTotal = 0.0;
+    int benchmarkSamples = 0;
+    vector<float> benchmarkMs;
+    bool benchmarking = options.lightBenchmark || options.aaBenchmark;
+
+    // Antialiasing benchmark: none, MSAA 2x/4x/8x, then FXAA alone
+    const int AA_BENCHMARK_SAMPLES[] = { 1, 2, 4, 8, 1 };
+    const int AA_BENCHMARK_RUNS = sizeof(AA_BENCHMARK_SAMPLES) / sizeof(AA_BENCHMARK_SAMPLES[0]);
+    vector<int> benchmarkMsaa;  // Samples each run got, after the driver's limit
+
+    // Scene is rendered offscreen so that its depth can be sampled
+    RenderTarget *target = new RenderTarget();
+
+    // Antialiasing: MSAA while drawing on the forward paths, FXAA on the way to the window
+    int msaa = options.msaa;
+    bool fxaa = options.fxaa;
+    Fxaa *fxaaPass = new Fxaa();
+    if (msaa > RenderTarget::maxSamples()) {
+        cout << "MSAA " << msaa << "x unsupported, using " << RenderTarget::maxSamples() << "x" << endl;
+    }
+    if (msaa > 1 && shading == SHADING_DEFERRED) {
+        cout << "MSAA applies to forward & clustered shading only" << endl;
+    }
 
-        // Texture coordinates attrib
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-    glBindVertexArray(0);
+    HiZ *hiz = NULL;
+    OcclusionBuffer *occlusion = NULL;
+    if (!cpuOcclusion) {
+        hiz = new HiZ();
+        hiz->setBounds(bounds);
+        hiz->setLods(packed.lods.data(), packed.lods.size(), firstIndex, baseVertex);
+    } else {
+        occlusion = new OcclusionBuffer();
+    }
+
+    // Meshes of a single meshlet gain nothing over object culling
+    ClusterCuller *clusters = NULL;
+    if (hiz && packed.meshlets.size() > 1 && ClusterCuller::supported()) {
+        clusters = new ClusterCuller(OBJECTS, CLUSTER_COMMANDS);
+        clusters->setMeshlets(packed.meshlets.data(), packed.meshlets.size(), packed.lods[0], firstIndex);
+    }
+    vector<float> distances(OBJECTS);
+    vector<unsigned> occluders(OBJECTS);
+    vector<char> occluded(OBJECTS);
+
+    // Culling results
+    vector<unsigned> visible(OBJECTS);
+
+    // Lod per visible object; without indirect draws objects are drawn grouped by lod
+    vector<unsigned> drawLods(OBJECTS);
+    vector<mat4> lodMvps(OBJECTS);
+    vector<mat4> lodModels(OBJECTS);
+    vector<size_t> lodFirst(packed.lods.size() + 1);
+    CullStats cullStats;
+
+    // Mouse position of a pending pick, -1 if none
+    int pickX = -1, pickY = -1;
+
+    FixedTimestep timestep(SIMULATION_STEP);
+    Uint64 lastCounter = SDL_GetPerformanceCounter();
+
+    // Animation runs until paused; a redraw is also due after anything visible changed
+    bool animating = true;
+    bool redraw = true;
+
+    FramePacer pacer(options.fpsLimit);
+    LatencyTracker latency;
+
+    // Scene resolution follows GPU time when a target frame rate is given
+    GpuTimer *gpuTimer = new GpuTimer();
+    ResolutionScaler *scaler = NULL;
+    if (options.dynamicResolutionFps > 0.0) {
+        scaler = new ResolutionScaler(1000.f / options.dynamicResolutionFps);
+    }
+
+    // F12 records the window; reads come back a few frames later & are encoded off-thread
+    FrameCapture *capture = new FrameCapture(options.captureFormat, options.capturePath, options.captureFps);
+    if (options.record) {
+        capture->start();
+    }
+
+    // Stats are shown in the window title once a second
+    Uint32 statsTime = SDL_GetTicks();
+    int statsFrames = 0;
 
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     for(;;) {
-        // Count time
-        float time = SDL_GetTicks() / 1000.f;
+        // Low latency: sleep off the frame first, so input is sampled right before rendering
+        if (options.lowLatency) {
+            pacer.wait();
+        }
+
+        // Idle: nothing changes on screen, sleep until an event arrives
+        if (options.idle && !animating && !redraw) {
+            if (!SDL_WaitEventTimeout(NULL, IDLE_TIMEOUT_MS)) {
+                latency.poll();
+                capture->poll();
+                deletionQueue.endFrame();
+                continue;
+            }
+        }
+
+        // Simulate the real time passed in fixed steps; paused time doesn't count
+        Uint64 counter = SDL_GetPerformanceCounter();
+        double elapsed = double(counter - lastCounter) / SDL_GetPerformanceFrequency();
+        lastCounter = counter;
+        int steps = animating ? timestep.advance(elapsed) : 0;
+        for (int s = 0; s < steps; ++s) {
+            spin.swap(previousSpin);
+            for (int i = 0; i < OBJECTS; ++i) {
+                spin[i] = wrapAngle(previousSpin[i] + (spinning[i] ? SPIN_SPEED * float(SIMULATION_STEP) : 0.f));
+            }
+        }
+        float alpha = timestep.alpha();
 
-        // Count resolution & set viewport
+        // Count resolution
         int W, H;
         SDL_GetWindowSize(win, &W, &H);
-        glViewport(0, 0, W, H);
 
         // Event loop
         bool quit = 0;
+        Uint32 inputTime = 0;  // Oldest input this frame reacts to
         SDL_Event e;
         while (SDL_PollEvent(&e) != 0) {
             if (e.type == SDL_QUIT) {
                 quit = 1;
             }
+            if ((e.type == SDL_KEYDOWN || e.type == SDL_MOUSEBUTTONDOWN || e.type == SDL_MOUSEMOTION) && inputTime == 0) {
+                inputTime = std::max(e.common.timestamp, 1u);
+            }
+            if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
+                pickX = e.button.x;
+                pickY = e.button.y;
+                redraw = true;
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_SPACE) {
+                animating = !animating;
+                redraw = true;
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_f && !benchmarking) {
+                shading = ShadingPath((shading + 1) % SHADING_PATHS);
+                cout << "Shading " << shadingPathName(shading) << endl;
+                redraw = true;
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F12) {
+                if (capture->recording) {
+                    capture->stop();
+                    cout << "Capture stopped after " << capture->frames << " frames ("
+                         << capture->dropped << " dropped)" << endl;
+                } else {
+                    capture->start();
+                    cout << "Capturing " << captureFormatName(capture->format) << " to "
+                         << capture->path << "_" << capture->recordings << endl;
+                }
+                redraw = true;
+            }
+            if (e.type == SDL_WINDOWEVENT && (e.window.event == SDL_WINDOWEVENT_EXPOSED
+                    || e.window.event == SDL_WINDOWEVENT_RESIZED || e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
+                redraw = true;
+            }
         }
         if (quit) break;
 
-        // Render
-        glClearColor(0.2f, 0.3f, 0.3f, 1.f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Input that changed nothing, e.g. mouse motion
+        if (options.idle && !animating && !redraw) {
+            continue;
+        }
+        redraw = false;
 
-        program->use();
+        // Benchmark: on to the next run once this one has its frames
+        if (options.lightBenchmark && (benchmarkRun < 0 || benchmarkFrame == BENCHMARK_WARMUP + BENCHMARK_FRAMES)) {
+            if (benchmarkRun >= 0) {
+                benchmarkMs.push_back(benchmarkSamples ? benchmarkTotal / benchmarkSamples : 0.0);
+            }
+            if (++benchmarkRun == BENCHMARK_RUNS) {
+                printf("Lights  Forward ms  Deferred ms  Clustered ms\n");
+                for (int r = 0; r < BENCHMARK_RUNS; r += SHADING_PATHS) {
+                    printf("%6d  %10.2f  %11.2f  %12.2f\n", BENCHMARK_LIGHTS[r / SHADING_PATHS],
+                            benchmarkMs[r + SHADING_FORWARD], benchmarkMs[r + SHADING_DEFERRED],
+                            benchmarkMs[r + SHADING_CLUSTERED]);
+                }
+                break;
+            }
+            shading = ShadingPath(benchmarkRun % SHADING_PATHS);
+            lights->set(scatterLights(BENCHMARK_LIGHTS[benchmarkRun / SHADING_PATHS], lightsCenter, lightsExtent, LIGHT_RADIUS));
+            benchmarkFrame = 0;
+            benchmarkTotal = 0.0;
+            benchmarkSamples = 0;
+        }
+
+        // Antialiasing benchmark: on to the next setting likewise
+        if (options.aaBenchmark && (benchmarkRun < 0 || benchmarkFrame == BENCHMARK_WARMUP + BENCHMARK_FRAMES)) {
+            if (benchmarkRun >= 0) {
+                benchmarkMs.push_back(benchmarkSamples ? benchmarkTotal / benchmarkSamples : 0.0);
+                benchmarkMsaa.push_back(target->samples);
+            }
+            if (++benchmarkRun == AA_BENCHMARK_RUNS) {
+                printf("Antialiasing  GPU ms  Over none\n");
+                for (int r = 0; r < AA_BENCHMARK_RUNS; ++r) {
+                    char name[32];
+                    if (r == AA_BENCHMARK_RUNS - 1) {
+                        snprintf(name, sizeof(name), "FXAA");
+                    } else if (benchmarkMsaa[r] > 1) {
+                        snprintf(name, sizeof(name), "MSAA %dx", benchmarkMsaa[r]);
+                    } else {
+                        snprintf(name, sizeof(name), "none");
+                    }
+                    printf("%-12s  %6.2f  %+9.2f\n", name, benchmarkMs[r], benchmarkMs[r] - benchmarkMs[0]);
+                }
+                break;
+            }
+            msaa = AA_BENCHMARK_SAMPLES[benchmarkRun];
+            fxaa = benchmarkRun == AA_BENCHMARK_RUNS - 1;
+            benchmarkFrame = 0;
+            benchmarkTotal = 0.0;
+            benchmarkSamples = 0;
+        }
+
+        // Render, at a fraction of the window size under load. The scaler goes by
+        // the scene alone, the present pass costs the same at any scale.
+        if (gpuTimer->poll()) {
+            if (scaler) {
+                scaler->update(gpuTimer->splitMilliseconds);
+            }
+            if (benchmarking && benchmarkFrame >= BENCHMARK_WARMUP) {
+                benchmarkTotal += gpuTimer->milliseconds;
+                ++benchmarkSamples;
+            }
+        }
+        float renderScale = scaler ? scaler->current : 1.f;
+        target->setSamples(shading == SHADING_DEFERRED ? 1 : msaa);
+        target->resize(std::max(1, int(W * renderScale + 0.5f)), std::max(1, int(H * renderScale + 0.5f)));
+        deferred->resize(*target);
+        gpuTimer->begin();
 
         // Transformations
-        mat4 projection = perspective(float(M_PI) / 3.f, float(W) / float(H), 0.1f, 100.f);
-        program->setMatrix4fv("projection", 1, value_ptr(projection));
+        float fovy = float(M_PI) / 3.f;
+        mat4 projection = perspective(fovy, float(W) / float(H), CAMERA_NEAR, CAMERA_FAR);
 
-        mat4 view = lookAt(vec3(0.f, 0.f, -5.f),
+        mat4 view = lookAt(vec3(0.f, 0.f, -OBJECTS_SIDE * OBJECTS_SPACING * 1.5f),
                            vec3(0.f),
                            vec3(0.f, 1.f, 0.f));
-        program->setMatrix4fv("view", 1, value_ptr(view));
 
-        mat4 model = mat4(1.f);
-        model = rotate(model, time * 2.f, vec3(0.5f, 1.f, 0.0f));
-        
-        program->setMatrix4fv("model", 1, value_ptr(model));
+        mat4 viewProjection = projection * view;
+        vec3 eye = vec3(inverse(view)[3]);
+
+        // Clusters' light lists
+        if (shading == SHADING_CLUSTERED) {
+            lightGrid->assign(*lights, value_ptr(view), value_ptr(projection), CAMERA_NEAR, CAMERA_FAR, jobs);
+        }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, sizeof(indices)/sizeof(indices[0]), GL_UNSIGNED_INT, 0);
+        // Lit while drawing, or material & normal into the G-buffer
+        auto useGeometryProgram = [&]() {
+            if (shading == SHADING_DEFERRED) {
+                gbufferProgram->use();
+                return;
+            }
+            ShaderProgram *lit = shading == SHADING_CLUSTERED ? clusteredProgram : program;
+            lit->use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, lights->texture);
+            lit->set1i("lights", 0);
+            lit->set1i("lightCount", lights->count);
+            lit->set3f("eye", eye.x, eye.y, eye.z);
+            if (shading == SHADING_CLUSTERED) {
+                lightGrid->bind(*lit, 1, 2, target->width, target->height);
+            }
+            shadows->bind(*lit, 4);
+        };
+
+        // Shadow casters per cascade; static ones only while their cached tile is stale
+        shadows->fit(value_ptr(view), fovy, float(W) / float(H), CAMERA_NEAR, CAMERA_FAR);
+        for (int c = 0; c < CascadedShadows::CASCADES; ++c) {
+            size_t count = bvh.cull(Frustum(shadows->viewProjection[c]), casters.data());
+            bool drawStatic = !shadows->caching || shadows->staticStale(c);
+            dynamicCasters[c].clear();
+            staticCasters[c].clear();
+            for (size_t k = 0; k < count; ++k) {
+                unsigned i = casters[k];
+                if (spinning[i]) {
+                    dynamicCasters[c].push_back(i);
+                } else if (drawStatic) {
+                    staticCasters[c].push_back(i);
+                }
+            }
+        }
+
+        // Picking
+        if (pickX >= 0) {
+            mat4 inv = inverse(viewProjection);
+            vec2 ndc(2.f * pickX / W - 1.f, 1.f - 2.f * pickY / H);
+            vec4 nearPoint = inv * vec4(ndc, -1.f, 1.f);
+            vec4 farPoint  = inv * vec4(ndc,  1.f, 1.f);
+            vec3 origin = vec3(nearPoint) / nearPoint.w;
+            vec3 dir = vec3(farPoint) / farPoint.w - origin;
+
+            int picked = bvh.raycast(value_ptr(origin), value_ptr(dir));
+            if (picked >= 0) {
+                cout << "Picked object " << picked << endl;
+            }
+            pickX = pickY = -1;
+        }
+
+        // Cull, then transform only visible objects
+        Frustum frustum(value_ptr(viewProjection));
+        size_t visibleCount = bvh.cull(frustum, visible.data());
+
+        auto spinObjects = [&](const unsigned *objects, size_t count) {
+            jobs.parallelFor(0, count, OBJECTS_CHUNK, [&](size_t from, size_t to) {
+                for (size_t j = from; j < to; ++j) {
+                    unsigned i = objects[j];
+                    // The short way round, across the wrap too
+                    setSpin(i, previousSpin[i] + remainder(spin[i] - previousSpin[i], TWO_PI) * alpha);
+                }
+            });
+        };
+        spinObjects(visible.data(), visibleCount);
+        for (int c = 0; c < CascadedShadows::CASCADES; ++c) {
+            spinObjects(dynamicCasters[c].data(), dynamicCasters[c].size());
+        }
+        transforms.update(jobs, OBJECTS_CHUNK);
+        jobs.parallelFor(0, visibleCount, OBJECTS_CHUNK, [&](size_t from, size_t to) {
+            for (size_t j = from; j < to; ++j) {
+                memcpy(value_ptr(models[j]), transforms.worldMatrix(1 + visible[j]), sizeof(mat4));
+            }
+            mulMat4Batch(value_ptr(viewProjection), value_ptr(models[from]), value_ptr(mvps[from]), to - from);
+        });
+
+        cullStats.tested += OBJECTS;
+
+        if (occlusion) {
+            // Nearest objects become occluders
+            for (size_t j = 0; j < visibleCount; ++j) {
+                distances[j] = distance(eye, positions[visible[j]]);
+                occluders[j] = j;
+            }
+            size_t occluderCount = min(OCCLUDERS, visibleCount);
+            partial_sort(occluders.begin(), occluders.begin() + occluderCount, occluders.begin() + visibleCount,
+                    [&](unsigned a, unsigned b) { return distances[a] < distances[b]; });
+
+            occlusion->clear();
+            for (size_t k = 0; k < occluderCount; ++k) {
+                occlusion->addOccluder(value_ptr(mvps[occluders[k]]), mesh.vertices.data(), mesh.stride,
+                        mesh.indices.data() + occluderFirstIndex, packed.lods[0].indexCount);
+            }
+            occlusion->rasterize(jobs);
+
+            jobs.parallelFor(0, visibleCount, OBJECTS_CHUNK, [&](size_t from, size_t to) {
+                for (size_t j = from; j < to; ++j) {
+                    unsigned i = visible[j];
+                    float center[3] = { bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] };
+                    float extent[3] = { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] };
+                    occluded[j] = !occlusion->testBox(value_ptr(viewProjection), center, extent);
+                }
+            });
+
+            // Compact survivors
+            size_t n = 0;
+            for (size_t j = 0; j < visibleCount; ++j) {
+                if (!occluded[j]) {
+                    visible[n] = visible[j];
+                    models[n] = models[j];
+                    mvps[n] = mvps[j];
+                    ++n;
+                }
+            }
+            cullStats.occluded += visibleCount - n;
+            visibleCount = n;
+        }
+
+        cullStats.visible += visibleCount;
+
+        // Coarsest lod within a pixel of the full mesh
+        float scale = lodScale(fovy, target->height);
+        for (size_t j = 0; j < visibleCount; ++j) {
+            drawLods[j] = selectLod(packed.lods, distance(eye, positions[visible[j]]), scale);
+        }
+
+        // Shadows: stale static tiles, then dynamic casters over a copy of the cache
+        glBindVertexArray(pool->vao);
+        for (int c = 0; c < CascadedShadows::CASCADES; ++c) {
+            if (shadows->caching && shadows->staticStale(c)) {
+                shadows->beginStatic(c);
+                drawCasters(staticCasters[c], c);
+            }
+        }
+        shadows->beginDynamic();
+        for (int c = 0; c < CascadedShadows::CASCADES; ++c) {
+            shadows->beginCascade(c);
+            drawCasters(dynamicCasters[c], c);
+            if (!shadows->caching) {
+                drawCasters(staticCasters[c], c);
+            }
+        }
+        shadows->end();
+        pointInstances(0);
+        glBindVertexArray(0);
+
+        target->bind();
+        glClearColor(0.2f, 0.3f, 0.3f, 1.f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (shading == SHADING_DEFERRED) {
+            deferred->bindGBuffer();
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
+        glBufferData(GL_ARRAY_BUFFER, OBJECTS * sizeof(mat4), NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, OBJECTS * sizeof(mat4), NULL, GL_STREAM_DRAW);
+
+        size_t indexBytes = indexSize(packed.indices.type);
+        if (hiz) {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, visibleCount * sizeof(mat4), mvps.data());
+            glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, visibleCount * sizeof(mat4), models.data());
+
+            // Occlusion test against last frame's depth
+            hiz->cull(visible.data(), drawLods.data(), visibleCount);
+
+            // Then meshlets of the finest lod against the frustum & their normal cones
+            if (clusters) {
+                clusters->cull(*hiz, value_ptr(models[0]), visibleCount, frustum, value_ptr(eye));
+            }
+
+            useGeometryProgram();
+            glBindVertexArray(pool->vao);
+            if (clusters) {
+                clusters->draw(packed.indices.type);
+            } else {
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, hiz->commandBuffer);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, packed.indices.type, 0, visibleCount, 0);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            }
+        } else {
+            // Counting sort by lod
+            fill(lodFirst.begin(), lodFirst.end(), 0);
+            for (size_t j = 0; j < visibleCount; ++j) {
+                ++lodFirst[drawLods[j] + 1];
+            }
+            for (size_t l = 0; l < packed.lods.size(); ++l) {
+                lodFirst[l + 1] += lodFirst[l];
+            }
+            vector<size_t> next(lodFirst.begin(), lodFirst.end() - 1);
+            for (size_t j = 0; j < visibleCount; ++j) {
+                size_t k = next[drawLods[j]]++;
+                lodMvps[k] = mvps[j];
+                lodModels[k] = models[j];
+            }
+            glBufferSubData(GL_ARRAY_BUFFER, 0, visibleCount * sizeof(mat4), lodMvps.data());
+            glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, visibleCount * sizeof(mat4), lodModels.data());
+
+            useGeometryProgram();
+            glBindVertexArray(pool->vao);
+            for (size_t l = 0; l < packed.lods.size(); ++l) {
+                size_t instances = lodFirst[l + 1] - lodFirst[l];
+                if (instances == 0) {
+                    continue;
+                }
+                pointInstances(lodFirst[l]);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, packed.lods[l].indexCount, packed.indices.type,
+                        (void*)((firstIndex + packed.lods[l].firstIndex) * indexBytes), instances, baseVertex);
+            }
+            pointInstances(0);
+        }
 
         glBindVertexArray(0);
 
+        if (shading == SHADING_DEFERRED) {
+            deferred->ambientProgram->use();
+            shadows->bind(*deferred->ambientProgram, 4);
+            deferred->shade(*target, *lights, value_ptr(viewProjection), value_ptr(eye));
+        }
+
+        // Samples averaged down; the pyramid is built from one sample's depth
+        target->resolve();
+
+        if (hiz) {
+            hiz->build(target->depth, target->width, target->height, value_ptr(viewProjection));
+        }
+
+        // Upscaled to the window, through FXAA if on
+        gpuTimer->split();
+        if (fxaa) {
+            fxaaPass->apply(*target, W, H);
+        } else {
+            target->blitToScreen(W, H);
+        }
+
+        gpuTimer->end();
+        capture->capture(W, H);
         SDL_GL_SwapWindow(win);
+
+        // Low latency: don't let the driver queue frames ahead
+        if (options.lowLatency) {
+            glFinish();
+        }
+        latency.submitted(inputTime);
+        latency.poll();
+        capture->poll();
+
+        // Objects released this frame are deleted once the GPU is past it
+        deletionQueue.endFrame();
+        ++benchmarkFrame;
+
+        // Stats
+        ++statsFrames;
+        Uint32 now = SDL_GetTicks();
+        if (now - statsTime >= 1000) {
+            char recording[64] = "";
+            if (capture->recording) {
+                snprintf(recording, sizeof(recording), " | rec %u (dropped %u)", capture->frames, capture->dropped);
+            }
+            char antialiasing[32] = "no aa";
+            if (target->samples > 1) {
+                snprintf(antialiasing, sizeof(antialiasing), fxaa ? "msaa %dx + fxaa" : "msaa %dx", target->samples);
+            } else if (fxaa) {
+                snprintf(antialiasing, sizeof(antialiasing), "fxaa");
+            }
+            char title[352];
+            snprintf(title, sizeof(title), "%.1f fps | gpu %.2f ms at %.0f%% | %s, %zu lights, %s | visible %zu, culled %zu (occluded %zu) of %d | latency %.1f ms (max %.0f)%s",
+                    statsFrames * 1000.f / (now - statsTime), gpuTimer->milliseconds, renderScale * 100.f,
+                    shadingPathName(shading), lights->count, antialiasing,
+                    cullStats.visible / statsFrames, cullStats.culled() / statsFrames,
+                    cullStats.occluded / statsFrames, OBJECTS,
+                    latency.average(), latency.worst, recording);
+            SDL_SetWindowTitle(win, title);
+
+            statsTime = now;
+            statsFrames = 0;
+            cullStats = CullStats();
+            latency.reset();
+        }
+
+        if (!options.lowLatency) {
+            pacer.wait();
+        }
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers     (1, &VBO);
+    delete scaler;
+    delete fxaaPass;
+    delete gpuTimer;
+    delete shadows;
+    delete lightGrid;
+    delete deferred;
+    delete lights;
+    delete clusters;
+    delete hiz;
+    delete occlusion;
+    delete pool;
+    delete target;
+    delete program;
+    delete gbufferProgram;
+    delete clusteredProgram;
+    instanceVBO.reset();
+    modelVBO.reset();
+    shadowVBO.reset();
+    latency.clear();
+
+    // Reads still in flight are written out before the encoder finishes
+    capture->clear();
+    delete capture;
+
+    // Everything still queued goes before the context does
+    deletionQueue.flush();
 
     SDL_GL_DeleteContext(cont);
     SDL_DestroyWindow(win);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Indexed triangle list with interleaved float vertices.
+// Position is always the first 3 floats of a vertex.
+struct Mesh {
+    std::vector<float> vertices;
+    std::vector<unsigned> indices;
+    unsigned stride;  // Floats per vertex
+
+    Mesh(unsigned stride = 3) : stride(stride) {}
+
+    size_t vertexCount() const { return this->vertices.size() / this->stride; }
+    const float *position(size_t vertex) const { return &this->vertices[vertex * this->stride]; }
+};
+
+// Range of a mesh's index buffer drawing one level of detail
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;  // Object space deviation from the full mesh
+    uint32_t reserved;
+};
@@ -0,0 +1,224 @@
+#include "meshcache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char MESH_CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+static const size_t MESH_CACHE_ALIGNMENT = 16;
+
+static uint64_t align(uint64_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(uint64_t)(MESH_CACHE_ALIGNMENT - 1);
+}
+
+static bool sourceStamp(const char *path, uint64_t &size, int64_t &time) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+    size = st.st_size;
+    time = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+// Packed mesh
+
+void packMesh(const Mesh &mesh, PackedMesh &packed, const vector<MeshLod> &lods) {
+    packed.vertices = packed.format.encode(mesh);
+    packed.vertexCount = mesh.vertexCount();
+    packed.indices = IndexBuffer(mesh.indices.data(), mesh.indices.size(), mesh.vertexCount());
+
+    packed.lods = lods;
+    if (packed.lods.empty()) {
+        MeshLod all = { 0, (uint32_t)mesh.indices.size(), 0.f, 0 };
+        packed.lods.push_back(all);
+    }
+    packed.meshlets = buildMeshlets(mesh, packed.lods[0].firstIndex, packed.lods[0].indexCount);
+}
+
+// Writing
+
+bool writeMeshCache(const char *path, const PackedMesh &packed, const char *sourcePath) {
+    if (packed.format.attributes.size() > MESH_CACHE_MAX_ATTRIBUTES) {
+        cerr << "ERROR::MESH_CACHE::TOO_MANY_ATTRIBUTES" << endl;
+        return false;
+    }
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime)) {
+        cerr << "ERROR::MESH_CACHE::SOURCE_CANNOT_BE_OPENED " << sourcePath << endl;
+        return false;
+    }
+
+    header.attributeCount = packed.format.attributes.size();
+    for (size_t i = 0; i < packed.format.attributes.size(); ++i) {
+        const VertexAttribute &a = packed.format.attributes[i];
+        header.attributes[i].location = a.location;
+        header.attributes[i].components = a.components;
+        header.attributes[i].encoding = a.encoding;
+    }
+    header.vertexStride = packed.format.stride;
+    for (int k = 0; k < 3; ++k) {
+        header.boundsMin[k] = packed.format.boundsMin[k];
+        header.boundsExtent[k] = packed.format.boundsExtent[k];
+    }
+
+    header.indexType = packed.indices.type;
+    header.lodCount = packed.lods.size();
+    header.meshletCount = packed.meshlets.size();
+
+    header.vertexCount = packed.vertexCount;
+    size_t tables = packed.lods.size() * sizeof(MeshLod) + packed.meshlets.size() * sizeof(Meshlet);
+    header.vertexOffset = align(sizeof(header) + tables);
+    header.vertexBytes = packed.vertices.size();
+    header.indexCount = packed.indices.count;
+    header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+    header.indexBytes = packed.indices.bytes();
+
+    string temporary = string(path) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        cerr << "ERROR::MESH_CACHE::FILE_CANNOT_BE_WRITTEN " << path << endl;
+        return false;
+    }
+
+    static const char padding[MESH_CACHE_ALIGNMENT] = {};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(packed.lods.data(), sizeof(MeshLod), packed.lods.size(), file) == packed.lods.size();
+    ok = ok && fwrite(packed.meshlets.data(), sizeof(Meshlet), packed.meshlets.size(), file) == packed.meshlets.size();
+    size_t written = sizeof(header) + tables;
+    ok = ok && fwrite(padding, 1, header.vertexOffset - written, file) == header.vertexOffset - written;
+    ok = ok && fwrite(packed.vertices.data(), 1, header.vertexBytes, file) == header.vertexBytes;
+    written = header.vertexOffset + header.vertexBytes;
+    ok = ok && fwrite(padding, 1, header.indexOffset - written, file) == header.indexOffset - written;
+    ok = ok && fwrite(packed.indices.data.data(), 1, header.indexBytes, file) == header.indexBytes;
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok || rename(temporary.c_str(), path) != 0) {
+        remove(temporary.c_str());
+        cerr << "ERROR::MESH_CACHE::FILE_CANNOT_BE_WRITTEN " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+// Reading
+
+// Every index of the stream names a vertex
+static bool indicesInRange(const unsigned char *data, GLenum type, uint64_t count, uint64_t vertexCount) {
+    size_t size = indexSize(type);
+    for (uint64_t i = 0; i < count; ++i) {
+        uint32_t index = 0;
+        memcpy(&index, data + i * size, size);  // Little endian
+        if (index >= vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tables & streams of a header that already fits the file agree with each other
+static bool validContents(const MeshCacheHeader *h, const MeshLod *lods, const Meshlet *meshlets,
+        const unsigned char *indices) {
+    if (h->lodCount == 0) {
+        return false;
+    }
+    for (uint32_t l = 0; l < h->lodCount; ++l) {
+        if ((uint64_t)lods[l].firstIndex + lods[l].indexCount > h->indexCount || lods[l].indexCount % 3 != 0) {
+            return false;
+        }
+    }
+    for (uint32_t m = 0; m < h->meshletCount; ++m) {
+        if (meshlets[m].firstIndex < lods[0].firstIndex
+                || (uint64_t)meshlets[m].firstIndex + meshlets[m].indexCount
+                   > (uint64_t)lods[0].firstIndex + lods[0].indexCount) {
+            return false;
+        }
+    }
+    return indicesInRange(indices, h->indexType, h->indexCount, h->vertexCount);
+}
+
+MeshCache::MeshCache(const char *path)
+        : file(path), header(NULL), lods(NULL), meshlets(NULL), vertices(NULL), indices(NULL), loaded(false) {
+    // A missing or outdated cache is normal, just not loaded
+    if (!this->file.valid() || this->file.size < sizeof(MeshCacheHeader)) {
+        return;
+    }
+    const MeshCacheHeader *h = (const MeshCacheHeader*)this->file.data;
+    if (memcmp(h->magic, MESH_CACHE_MAGIC, sizeof(h->magic)) != 0 || h->version != MESH_CACHE_VERSION) {
+        return;
+    }
+
+    // Anything else off is a corrupt file, left unloaded to be rebuilt
+    bool valid = h->attributeCount <= MESH_CACHE_MAX_ATTRIBUTES
+        && (h->indexType == GL_UNSIGNED_BYTE || h->indexType == GL_UNSIGNED_SHORT || h->indexType == GL_UNSIGNED_INT)
+        && h->vertexOffset <= this->file.size && h->vertexBytes <= this->file.size - h->vertexOffset
+        && h->indexOffset <= this->file.size && h->indexBytes <= this->file.size - h->indexOffset
+        && sizeof(MeshCacheHeader) + (uint64_t)h->lodCount * sizeof(MeshLod)
+           + (uint64_t)h->meshletCount * sizeof(Meshlet) <= h->vertexOffset
+        && h->vertexOffset + h->vertexBytes <= h->indexOffset;
+
+    // Positions are decoded as 3 floats or unorm16s
+    bool position = false;
+    for (uint32_t i = 0; valid && i < h->attributeCount; ++i) {
+        const MeshCacheAttribute &a = h->attributes[i];
+        valid = a.components >= 1 && a.components <= 4 && a.encoding <= ATTRIBUTE_OCT_SNORM16;
+        if (valid && a.location == 0) {
+            position = a.components == 3 && (a.encoding == ATTRIBUTE_FLOAT || a.encoding == ATTRIBUTE_UNORM16);
+            valid = position;
+        }
+        if (valid) {
+            this->format.add(a.location, a.components, (AttributeEncoding)a.encoding);
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        this->format.boundsMin[k] = h->boundsMin[k];
+        this->format.boundsExtent[k] = h->boundsExtent[k];
+    }
+    valid = valid && position && this->format.stride == h->vertexStride
+        && h->vertexCount <= h->vertexBytes && h->vertexCount * h->vertexStride == h->vertexBytes
+        && h->indexCount <= h->indexBytes && h->indexCount * indexSize(h->indexType) == h->indexBytes;
+
+    const MeshLod *lods = (const MeshLod*)(this->file.data + sizeof(MeshCacheHeader));
+    const Meshlet *meshlets = (const Meshlet*)(lods + h->lodCount);
+    if (!valid || !validContents(h, lods, meshlets, this->file.data + h->indexOffset)) {
+        cerr << "ERROR::MESH_CACHE::FILE_CORRUPT " << path << endl;
+        return;
+    }
+
+    this->header = h;
+    this->lods = lods;
+    this->meshlets = meshlets;
+    this->vertices = this->file.data + h->vertexOffset;
+    this->indices = this->file.data + h->indexOffset;
+    this->loaded = true;
+
+    // Streams are read front to back right away, start reading them in
+    madvise((void*)this->file.data, this->file.size, MADV_WILLNEED);
+}
+
+bool MeshCache::isFresh(const char *sourcePath) const {
+    uint64_t size;
+    int64_t time;
+    return this->loaded && sourceStamp(sourcePath, size, time)
+        && size == this->header->sourceSize && time == this->header->sourceTime;
+}
+
+void MeshCache::decode(Mesh &mesh, const MeshLod &lod) const {
+    mesh.stride = 3;
+    mesh.vertices.resize(this->header->vertexCount * 3);
+    this->format.decodePositions(this->vertices, this->header->vertexCount, mesh.vertices.data());
+
+    mesh.indices.resize(lod.indexCount);
+    size_t offset = lod.firstIndex * indexSize(this->header->indexType);
+    unpackIndices(this->indices + offset, this->header->indexType, lod.indexCount, mesh.indices.data());
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "context.h"
+#include "indexbuffer.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "meshloader.h"
+#include "vertexformat.h"
+
+// Bump whenever the layout below, a vertex encoding or what gets stored changes
+const uint32_t MESH_CACHE_VERSION = 4;
+const uint32_t MESH_CACHE_MAX_ATTRIBUTES = 8;
+
+// Everything needed to draw a mesh, in GPU layout
+struct PackedMesh {
+    VertexFormat format;
+    std::vector<unsigned char> vertices;
+    size_t vertexCount;
+    IndexBuffer indices;
+    std::vector<MeshLod> lods;  // Finest first
+    std::vector<Meshlet> meshlets;  // Of the finest lod
+
+    PackedMesh() : vertexCount(0) {}
+};
+
+// Encodes mesh with packed.format, already holding the attributes.
+// Lods are given as index ranges of mesh.indices; none means one lod of all.
+// The finest lod is also cut into meshlets.
+void packMesh(const Mesh &mesh, PackedMesh &packed, const std::vector<MeshLod> &lods = std::vector<MeshLod>());
+
+struct MeshCacheAttribute {
+    uint32_t location;
+    uint32_t components;
+    uint32_t encoding;
+};
+
+// File layout: header, lod table, meshlet table, vertex stream, index stream;
+// streams are 16 byte aligned
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+
+    // Source file the cache was built from
+    uint64_t sourceSize;
+    int64_t sourceTime;
+
+    uint32_t attributeCount;
+    MeshCacheAttribute attributes[MESH_CACHE_MAX_ATTRIBUTES];
+    uint32_t vertexStride;
+    float boundsMin[3];
+    float boundsExtent[3];
+
+    uint32_t indexType;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t reserved;
+
+    uint64_t vertexCount;
+    uint64_t vertexOffset;
+    uint64_t vertexBytes;
+    uint64_t indexCount;
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+};
+
+// Writes packed next to sourcePath's stamp. Goes through a temporary file,
+// so readers never see a partial cache.
+bool writeMeshCache(const char *path, const PackedMesh &packed, const char *sourcePath);
+
+// Memory mapped cache; streams point into the mapping. Headers, tables
+// and index values are checked against the file, a corrupt cache is not loaded.
+struct MeshCache {
+    MappedFile file;
+    const MeshCacheHeader *header;
+    const MeshLod *lods;
+    const Meshlet *meshlets;
+    const unsigned char *vertices;
+    const unsigned char *indices;
+    VertexFormat format;
+    bool loaded;
+
+    MeshCache(const char *path);
+
+    // Built from sourcePath as it is now
+    bool isFresh(const char *sourcePath) const;
+
+    // Float positions & lod's indices widened to 32 bits, for CPU side use such as occlusion culling
+    void decode(Mesh &mesh, const MeshLod &lod) const;
+};
@@ -0,0 +1,127 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+// Sphere, cone & counts of triangles [first, first + indexCount)
+static void computeBounds(const Mesh &mesh, size_t first, size_t indexCount, Meshlet &meshlet) {
+    const unsigned *indices = &mesh.indices[first];
+
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < indexCount; ++i) {
+        const float *p = mesh.position(indices[i]);
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = min(lo[k], p[k]);
+            hi[k] = max(hi[k], p[k]);
+        }
+    }
+    float radius2 = 0.f;
+    for (int k = 0; k < 3; ++k) {
+        meshlet.center[k] = (lo[k] + hi[k]) * 0.5f;
+    }
+    for (size_t i = 0; i < indexCount; ++i) {
+        const float *p = mesh.position(indices[i]);
+        float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+        radius2 = max(radius2, dx * dx + dy * dy + dz * dz);
+    }
+    meshlet.radius = sqrtf(radius2);
+
+    // Unit triangle normals, their average is the cone axis
+    vector<float> normals;
+    float axis[3] = { 0.f, 0.f, 0.f };
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        const float *p0 = mesh.position(indices[t + 0]);
+        const float *p1 = mesh.position(indices[t + 1]);
+        const float *p2 = mesh.position(indices[t + 2]);
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+                       e1[2] * e2[0] - e1[0] * e2[2],
+                       e1[0] * e2[1] - e1[1] * e2[0] };
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.f) {
+            continue;
+        }
+        for (int k = 0; k < 3; ++k) {
+            normals.push_back(n[k] / length);
+            axis[k] += n[k] / length;
+        }
+    }
+
+    float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float minDot = 1.f;
+    if (length > 0.f) {
+        for (int k = 0; k < 3; ++k) {
+            axis[k] /= length;
+        }
+        for (size_t n = 0; n < normals.size(); n += 3) {
+            minDot = min(minDot, normals[n] * axis[0] + normals[n + 1] * axis[1] + normals[n + 2] * axis[2]);
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        meshlet.coneAxis[k] = axis[k];
+    }
+
+    // Normals spread over (nearly) a hemisphere or more: never backfacing.
+    // Otherwise the cone of view directions seeing only backs is the normal
+    // cone widened by 90 degrees, so its cutoff is sin of the normal cone's angle.
+    meshlet.coneCutoff = length == 0.f || minDot <= 0.1f ? 1.f : sqrtf(1.f - minDot * minDot);
+
+    meshlet.firstIndex = first;
+    meshlet.indexCount = indexCount;
+    meshlet.reserved = 0;
+}
+
+vector<Meshlet> buildMeshlets(const Mesh &mesh, size_t firstIndex, size_t indexCount,
+        unsigned maxVertices, unsigned maxTriangles) {
+    vector<Meshlet> meshlets;
+
+    // Meshlet each vertex was last added to
+    vector<unsigned> stamp(mesh.vertexCount(), ~0u);
+
+    size_t begin = firstIndex;
+    size_t end = firstIndex + indexCount - indexCount % 3;
+    size_t start = begin;
+    unsigned vertices = 0;
+
+    for (size_t t = begin; t < end; t += 3) {
+        unsigned current = meshlets.size();
+        unsigned added = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned v = mesh.indices[t + k];
+            bool repeated = (k > 0 && mesh.indices[t] == v) || (k > 1 && mesh.indices[t + 1] == v);
+            added += stamp[v] != current && !repeated;
+        }
+
+        if (vertices + added > maxVertices || (t - start) / 3 >= maxTriangles) {
+            Meshlet meshlet;
+            computeBounds(mesh, start, t - start, meshlet);
+            meshlet.vertexCount = vertices;
+            meshlets.push_back(meshlet);
+
+            start = t;
+            vertices = 0;
+            current = meshlets.size();
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            unsigned v = mesh.indices[t + k];
+            if (stamp[v] != current) {
+                stamp[v] = current;
+                ++vertices;
+            }
+        }
+    }
+
+    if (end > start) {
+        Meshlet meshlet;
+        computeBounds(mesh, start, end - start, meshlet);
+        meshlet.vertexCount = vertices;
+        meshlets.push_back(meshlet);
+    }
+    return meshlets;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+const unsigned MESHLET_MAX_VERTICES = 64;
+const unsigned MESHLET_MAX_TRIANGLES = 124;
+
+// Small cluster of triangles, a contiguous range of the index buffer.
+// Laid out to be uploaded as is to a std430 buffer.
+struct Meshlet {
+    // Bounding sphere
+    float center[3];
+    float radius;
+
+    // Normal cone: seen from eye, all triangles face away when
+    // dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius.
+    // A cutoff of 1 never culls.
+    float coneAxis[3];
+    float coneCutoff;
+
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t reserved;
+};
+
+// Cuts the index range [firstIndex, firstIndex + indexCount) of mesh into
+// meshlets in triangle order, so a vertex cache optimized order gives
+// compact ones. The index buffer itself is left as it is.
+std::vector<Meshlet> buildMeshlets(const Mesh &mesh, size_t firstIndex, size_t indexCount,
+        unsigned maxVertices = MESHLET_MAX_VERTICES, unsigned maxTriangles = MESHLET_MAX_TRIANGLES);
@@ -0,0 +1,952 @@
+#include "meshloader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Mapped file
+
+MappedFile::MappedFile(const char *path) : data(NULL), size(0) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+            this->data = (const unsigned char*)mapping;
+            this->size = st.st_size;
+        }
+    }
+    // The mapping keeps the file open
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (this->data) {
+        munmap((void*)this->data, this->size);
+    }
+}
+
+void MappedFile::release(size_t offset, size_t length) const {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = offset / page * page;
+    size_t end = min(offset + length, this->size);
+    if (this->data && end > begin) {
+        madvise((void*)(this->data + begin), end - begin, MADV_DONTNEED);
+    }
+}
+
+// Number parsing, without locale or NUL termination
+
+static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+static bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+static const char *skipBlank(const char *p, const char *end) {
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+static const char *skipLine(const char *p, const char *end) {
+    const char *newline = (const char*)memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+// Returns p if there is no number
+static const char *parseInt(const char *p, const char *end, int &out) {
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    const char *digits = p;
+    long value = 0;
+    while (p < end && isDigit(*p)) {
+        if (value < INT32_MAX) {
+            value = value * 10 + (*p - '0');
+        }
+        ++p;
+    }
+    if (p == digits) {
+        return start;
+    }
+
+    value = min(value, (long)INT32_MAX);
+    out = negative ? -value : value;
+    return p;
+}
+
+static const char *parseFloat(const char *p, const char *end, float &out) {
+    static const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    const uint64_t MANTISSA_LIMIT = 100000000000000000ull;
+
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; p < end && isDigit(*p); ++p, ++digits) {
+        if (mantissa < MANTISSA_LIMIT) {
+            mantissa = mantissa * 10 + (*p - '0');
+        } else {
+            ++exponent;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && isDigit(*p); ++p, ++digits) {
+            if (mantissa < MANTISSA_LIMIT) {
+                mantissa = mantissa * 10 + (*p - '0');
+                --exponent;
+            }
+        }
+    }
+    if (digits == 0) {
+        out = 0.f;
+        return start;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int e;
+        const char *next = parseInt(p + 1, end, e);
+        if (next != p + 1) {
+            exponent += e;
+            p = next;
+        }
+    }
+
+    double value = (double)mantissa;
+    if (exponent < 0) {
+        value = -exponent <= 22 ? value / POWERS_OF_TEN[-exponent] : value * pow(10.0, exponent);
+    } else if (exponent > 0) {
+        value = exponent <= 22 ? value * POWERS_OF_TEN[exponent] : value * pow(10.0, exponent);
+    }
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+// OBJ
+
+namespace {
+
+// Chunks are cut at the first line break after this many bytes
+const size_t OBJ_CHUNK_SIZE = 4 << 20;
+
+// Floats per position, texture coordinates & normal
+const int OBJ_ATTRIBUTE_SIZE[3] = { 3, 2, 3 };
+
+// Position, texture coordinates & normal indices of a face corner, -1 if
+// missing. Negative (relative) indices in the file are resolved against the
+// chunk's own counts; bit k of local marks those, they get the chunk's
+// global offset added once it is known.
+struct ObjCorner {
+    int index[3];
+    unsigned char local;
+};
+
+struct ObjChunk {
+    vector<float> attributes[3];
+    vector<ObjCorner> corners;  // 3 per triangle
+
+    void clear() {
+        for (auto &a : this->attributes) {
+            a.clear();
+        }
+        this->corners.clear();
+    }
+};
+
+struct ObjKey {
+    int index[3];
+
+    bool operator==(const ObjKey &other) const {
+        return this->index[0] == other.index[0] && this->index[1] == other.index[1]
+            && this->index[2] == other.index[2];
+    }
+};
+
+struct ObjKeyHash {
+    size_t operator()(const ObjKey &key) const {
+        uint64_t h = (uint32_t)key.index[0];
+        h = h * 0x9e3779b97f4a7c15ull ^ (uint32_t)key.index[1];
+        h = h * 0x9e3779b97f4a7c15ull ^ (uint32_t)key.index[2];
+        return h ^ (h >> 29);
+    }
+};
+
+void parseObjChunk(const char *p, const char *end, ObjChunk &chunk) {
+    vector<ObjCorner> face;
+
+    while (p < end) {
+        p = skipBlank(p, end);
+
+        if (p + 1 < end && p[0] == 'v') {
+            int k = -1;
+            if (isBlank(p[1])) {
+                k = 0;
+                p += 1;
+            } else if (p + 2 < end && p[1] == 't' && isBlank(p[2])) {
+                k = 1;
+                p += 2;
+            } else if (p + 2 < end && p[1] == 'n' && isBlank(p[2])) {
+                k = 2;
+                p += 2;
+            }
+            if (k >= 0) {
+                for (int c = 0; c < OBJ_ATTRIBUTE_SIZE[k]; ++c) {
+                    float value;
+                    p = parseFloat(skipBlank(p, end), end, value);
+                    chunk.attributes[k].push_back(value);
+                }
+            }
+        } else if (p + 1 < end && p[0] == 'f' && isBlank(p[1])) {
+            ++p;
+            face.clear();
+            while (true) {
+                p = skipBlank(p, end);
+
+                ObjCorner corner;
+                corner.local = 0;
+                int value;
+                const char *next = parseInt(p, end, value);
+                if (next == p) {
+                    break;
+                }
+                p = next;
+
+                for (int k = 0; k < 3; ++k) {
+                    if (k > 0) {
+                        // Empty as in 1//3
+                        if (p >= end || *p != '/') {
+                            corner.index[k] = -1;
+                            continue;
+                        }
+                        ++p;
+                        next = parseInt(p, end, value);
+                        if (next == p) {
+                            corner.index[k] = -1;
+                            continue;
+                        }
+                        p = next;
+                    }
+
+                    if (value > 0) {
+                        corner.index[k] = value - 1;
+                    } else if (value < 0) {
+                        corner.index[k] = (int)(chunk.attributes[k].size() / OBJ_ATTRIBUTE_SIZE[k]) + value;
+                        corner.local |= 1 << k;
+                    } else {
+                        corner.index[k] = -1;
+                    }
+                }
+                face.push_back(corner);
+            }
+
+            // Fan triangulation
+            for (size_t i = 2; i < face.size(); ++i) {
+                chunk.corners.push_back(face[0]);
+                chunk.corners.push_back(face[i - 1]);
+                chunk.corners.push_back(face[i]);
+            }
+        }
+
+        p = skipLine(p, end);
+    }
+}
+
+}
+
+bool loadObj(const char *path, Mesh &mesh, JobSystem &jobs) {
+    MappedFile file(path);
+    if (!file.valid()) {
+        cerr << "ERROR::MESH::FILE_CANNOT_BE_OPENED " << path << endl;
+        return false;
+    }
+    const char *data = (const char*)file.data;
+
+    // Chunk boundaries at line breaks
+    vector<size_t> bounds(1, 0);
+    while (bounds.back() < file.size) {
+        size_t next = bounds.back() + OBJ_CHUNK_SIZE;
+        if (next >= file.size) {
+            next = file.size;
+        } else {
+            next = skipLine(data + next, data + file.size) - data;
+        }
+        bounds.push_back(next);
+    }
+    size_t chunkCount = bounds.size() - 1;
+
+    mesh.stride = LOADED_MESH_STRIDE;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+
+    // Attributes of the whole file so far; faces may refer back to any of them
+    vector<float> attributes[3];
+    unordered_map<ObjKey, unsigned, ObjKeyHash> unique;
+
+    size_t batchSize = max(jobs.size(), 1u) * 2;
+    vector<ObjChunk> chunks(batchSize);
+    vector<size_t> offsets(batchSize * 3);
+
+    for (size_t first = 0; first < chunkCount; first += batchSize) {
+        size_t count = min(batchSize, chunkCount - first);
+
+        jobs.parallelFor(0, count, 1, [&](size_t from, size_t to) {
+            for (size_t c = from; c < to; ++c) {
+                chunks[c].clear();
+                parseObjChunk(data + bounds[first + c], data + bounds[first + c + 1], chunks[c]);
+            }
+        });
+
+        // Append attributes in file order
+        for (size_t c = 0; c < count; ++c) {
+            for (int k = 0; k < 3; ++k) {
+                offsets[c * 3 + k] = attributes[k].size() / OBJ_ATTRIBUTE_SIZE[k];
+                attributes[k].insert(attributes[k].end(),
+                        chunks[c].attributes[k].begin(), chunks[c].attributes[k].end());
+            }
+        }
+        size_t available[3];
+        for (int k = 0; k < 3; ++k) {
+            available[k] = attributes[k].size() / OBJ_ATTRIBUTE_SIZE[k];
+        }
+
+        // Resolve & deduplicate corners
+        for (size_t c = 0; c < count; ++c) {
+            for (const ObjCorner &corner : chunks[c].corners) {
+                ObjKey key;
+                for (int k = 0; k < 3; ++k) {
+                    long index = corner.index[k];
+                    if (corner.local & (1 << k)) {
+                        index += offsets[c * 3 + k];
+                    }
+                    if (index >= (long)available[k] || (index < 0 && (k == 0 || (corner.local & (1 << k))))) {
+                        cerr << "ERROR::MESH::OBJ_INDEX_OUT_OF_RANGE " << path << endl;
+                        return false;
+                    }
+                    key.index[k] = index;
+                }
+
+                auto inserted = unique.emplace(key, (unsigned)mesh.vertexCount());
+                if (inserted.second) {
+                    for (int k = 0; k < 3; ++k) {
+                        for (int i = 0; i < OBJ_ATTRIBUTE_SIZE[k]; ++i) {
+                            mesh.vertices.push_back(key.index[k] < 0 ? 0.f
+                                    : attributes[k][key.index[k] * OBJ_ATTRIBUTE_SIZE[k] + i]);
+                        }
+                    }
+                }
+                mesh.indices.push_back(inserted.first->second);
+            }
+        }
+
+        // Done with this part of the text
+        file.release(bounds[first], bounds[first + count] - bounds[first]);
+    }
+
+    return true;
+}
+
+// JSON, just enough for glTF
+
+namespace {
+
+// Deeper nesting is rejected rather than recursed into
+const int JSON_MAX_DEPTH = 64;
+
+struct Json {
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type = NUL;
+    double number = 0.0;
+    string text;
+    vector<string> keys;  // Objects only
+    vector<Json> items;
+
+    const Json *get(const char *key) const {
+        for (size_t i = 0; i < this->keys.size(); ++i) {
+            if (this->keys[i] == key) {
+                return &this->items[i];
+            }
+        }
+        return NULL;
+    }
+
+    double getNumber(const char *key, double fallback) const {
+        const Json *value = this->get(key);
+        return value && value->type == NUMBER ? value->number : fallback;
+    }
+
+    int getInt(const char *key, int fallback) const {
+        double value = this->getNumber(key, fallback);
+        return value >= INT_MIN && value <= INT_MAX ? (int)value : fallback;
+    }
+
+    // Whole number in [0, limit], 0 if missing; false for anything else
+    bool getSize(const char *key, size_t limit, size_t &out) const {
+        out = 0;
+        const Json *value = this->get(key);
+        if (!value) {
+            return true;
+        }
+        if (value->type != NUMBER || !(value->number >= 0.0 && value->number <= (double)limit)
+                || value->number != floor(value->number)) {
+            return false;
+        }
+        out = (size_t)value->number;
+        return true;
+    }
+
+    size_t size() const { return this->items.size(); }
+};
+
+struct JsonParser {
+    const char *p;
+    const char *end;
+
+    void skip() {
+        while (this->p < this->end && (*this->p == ' ' || *this->p == '\t' || *this->p == '\n' || *this->p == '\r')) {
+            ++this->p;
+        }
+    }
+
+    bool literal(const char *word) {
+        size_t n = strlen(word);
+        if ((size_t)(this->end - this->p) < n || strncmp(this->p, word, n) != 0) {
+            return false;
+        }
+        this->p += n;
+        return true;
+    }
+
+    bool parseString(string &out) {
+        if (this->p >= this->end || *this->p != '"') {
+            return false;
+        }
+        ++this->p;
+        while (this->p < this->end && *this->p != '"') {
+            char c = *this->p++;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (this->p >= this->end) {
+                return false;
+            }
+            c = *this->p++;
+            switch (c) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    if (this->end - this->p < 4) {
+                        return false;
+                    }
+                    unsigned code = strtoul(string(this->p, 4).c_str(), NULL, 16);
+                    this->p += 4;
+                    // Only ASCII matters for the keys & URIs we read
+                    out += code < 0x80 ? (char)code : '?';
+                    break;
+                }
+                default: out += c; break;
+            }
+        }
+        if (this->p >= this->end) {
+            return false;
+        }
+        ++this->p;
+        return true;
+    }
+
+    bool parse(Json &out, int depth = 0) {
+        this->skip();
+        if (this->p >= this->end) {
+            return false;
+        }
+
+        char c = *this->p;
+        if (c == '{' || c == '[') {
+            if (depth == JSON_MAX_DEPTH) {
+                return false;
+            }
+            bool object = c == '{';
+            char close = object ? '}' : ']';
+            out.type = object ? Json::OBJECT : Json::ARRAY;
+            ++this->p;
+            this->skip();
+            if (this->p < this->end && *this->p == close) {
+                ++this->p;
+                return true;
+            }
+            while (true) {
+                if (object) {
+                    this->skip();
+                    out.keys.emplace_back();
+                    if (!this->parseString(out.keys.back())) {
+                        return false;
+                    }
+                    this->skip();
+                    if (this->p >= this->end || *this->p != ':') {
+                        return false;
+                    }
+                    ++this->p;
+                }
+                out.items.emplace_back();
+                if (!this->parse(out.items.back(), depth + 1)) {
+                    return false;
+                }
+                this->skip();
+                if (this->p < this->end && *this->p == ',') {
+                    ++this->p;
+                    continue;
+                }
+                if (this->p < this->end && *this->p == close) {
+                    ++this->p;
+                    return true;
+                }
+                return false;
+            }
+        }
+        if (c == '"') {
+            out.type = Json::STRING;
+            return this->parseString(out.text);
+        }
+        if (this->literal("true")) {
+            out.type = Json::BOOLEAN;
+            out.number = 1.0;
+            return true;
+        }
+        if (this->literal("false")) {
+            out.type = Json::BOOLEAN;
+            return true;
+        }
+        if (this->literal("null")) {
+            return true;
+        }
+
+        // The text is NUL terminated, see GltfFile
+        char *next;
+        out.type = Json::NUMBER;
+        out.number = strtod(this->p, &next);
+        if (next == this->p) {
+            return false;
+        }
+        this->p = next;
+        return true;
+    }
+};
+
+int componentCount(const string &type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+size_t componentSize(GLenum type) {
+    switch (type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+float readComponent(const unsigned char *p, GLenum type, bool normalized) {
+    switch (type) {
+        case GL_FLOAT: {
+            float value;
+            memcpy(&value, p, 4);
+            return value;
+        }
+        case GL_UNSIGNED_BYTE:
+            return normalized ? *p / 255.f : *p;
+        case GL_BYTE:
+            return normalized ? max(*(const int8_t*)p / 127.f, -1.f) : *(const int8_t*)p;
+        case GL_UNSIGNED_SHORT: {
+            uint16_t value;
+            memcpy(&value, p, 2);
+            return normalized ? value / 65535.f : value;
+        }
+        case GL_SHORT: {
+            int16_t value;
+            memcpy(&value, p, 2);
+            return normalized ? max(value / 32767.f, -1.f) : value;
+        }
+        default:
+            return 0.f;
+    }
+}
+
+unsigned readIndex(const unsigned char *p, GLenum type) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+            return *p;
+        case GL_UNSIGNED_SHORT: {
+            uint16_t value;
+            memcpy(&value, p, 2);
+            return value;
+        }
+        default: {
+            uint32_t value;
+            memcpy(&value, p, 4);
+            return value;
+        }
+    }
+}
+
+}
+
+// glTF
+
+// Sizes in the JSON are bounded before any arithmetic on them: bytes by
+// GLTF_MAX_BYTES, elements of an accessor, and vertices & indices of the
+// whole mesh by GLTF_MAX_ELEMENTS
+static const size_t GLTF_MAX_BYTES = size_t(1) << 40;
+static const size_t GLTF_MAX_ELEMENTS = size_t(1) << 27;
+static const size_t GLTF_MAX_STRIDE = 252;
+
+size_t GltfAccessor::elementSize() const {
+    return componentSize(this->componentType) * this->components;
+}
+
+GltfFile::GltfFile(const char *path) : loaded(false) {
+    const uint32_t GLB_MAGIC = 0x46546c67;       // "glTF"
+    const uint32_t GLB_CHUNK_JSON = 0x4e4f534a;  // "JSON"
+    const uint32_t GLB_CHUNK_BIN = 0x004e4942;   // "BIN\0"
+
+    MappedFile *file = new MappedFile(path);
+    this->files.push_back(file);
+    if (!file->valid()) {
+        cerr << "ERROR::MESH::FILE_CANNOT_BE_OPENED " << path << endl;
+        return;
+    }
+
+    // Binary container: JSON chunk followed by the buffer
+    string text;
+    const unsigned char *bin = NULL;
+    size_t binSize = 0;
+    uint32_t header[3] = { 0, 0, 0 };
+    if (file->size >= sizeof(header)) {
+        memcpy(header, file->data, sizeof(header));
+    }
+    if (header[0] == GLB_MAGIC) {
+        if (header[1] != 2) {
+            cerr << "ERROR::MESH::GLTF_UNSUPPORTED_VERSION " << path << endl;
+            return;
+        }
+        size_t length = min((size_t)header[2], file->size);
+        size_t offset = sizeof(header);
+        while (offset + 8 <= length) {
+            uint32_t chunk[2];
+            memcpy(chunk, file->data + offset, 8);
+            offset += 8;
+            if (offset + chunk[0] > length) {
+                break;
+            }
+            if (chunk[1] == GLB_CHUNK_JSON) {
+                text.assign((const char*)file->data + offset, chunk[0]);
+            } else if (chunk[1] == GLB_CHUNK_BIN && !bin) {
+                bin = file->data + offset;
+                binSize = chunk[0];
+            }
+            offset += (chunk[0] + 3) & ~3u;
+        }
+    } else {
+        text.assign((const char*)file->data, file->size);
+    }
+
+    Json root;
+    JsonParser parser = { text.c_str(), text.c_str() + text.size() };
+    if (!parser.parse(root) || root.type != Json::OBJECT) {
+        cerr << "ERROR::MESH::GLTF_INVALID_JSON " << path << endl;
+        return;
+    }
+
+    // External buffers are relative to the file
+    string directory = path;
+    size_t slash = directory.find_last_of('/');
+    directory = slash == string::npos ? "" : directory.substr(0, slash + 1);
+
+    const Json *buffers = root.get("buffers");
+    for (size_t i = 0; buffers && i < buffers->size(); ++i) {
+        const Json &buffer = buffers->items[i];
+        const Json *uri = buffer.get("uri");
+        size_t byteLength;
+        if (!buffer.getSize("byteLength", GLTF_MAX_BYTES, byteLength)) {
+            cerr << "ERROR::MESH::GLTF_INVALID_BUFFER " << path << endl;
+            return;
+        }
+
+        if (!uri) {
+            if (!bin || binSize < byteLength) {
+                cerr << "ERROR::MESH::GLTF_MISSING_BUFFER " << path << endl;
+                return;
+            }
+            this->buffers.push_back(bin);
+            this->bufferSizes.push_back(byteLength);
+            continue;
+        }
+        if (uri->text.compare(0, 5, "data:") == 0) {
+            cerr << "ERROR::MESH::GLTF_DATA_URI_UNSUPPORTED " << path << endl;
+            return;
+        }
+
+        MappedFile *external = new MappedFile((directory + uri->text).c_str());
+        this->files.push_back(external);
+        if (!external->valid() || external->size < byteLength) {
+            cerr << "ERROR::MESH::GLTF_MISSING_BUFFER " << directory + uri->text << endl;
+            return;
+        }
+        this->buffers.push_back(external->data);
+        this->bufferSizes.push_back(byteLength);
+    }
+
+    const Json *views = root.get("bufferViews");
+    for (size_t i = 0; views && i < views->size(); ++i) {
+        const Json &view = views->items[i];
+        GltfBufferView v;
+        v.buffer = view.getInt("buffer", -1);
+        bool sizes = view.getSize("byteOffset", GLTF_MAX_BYTES, v.byteOffset)
+                  && view.getSize("byteLength", GLTF_MAX_BYTES, v.byteLength)
+                  && view.getSize("byteStride", GLTF_MAX_STRIDE, v.byteStride);
+        if (!sizes || v.buffer < 0 || v.buffer >= (int)this->buffers.size()
+                || v.byteOffset + v.byteLength > this->bufferSizes[v.buffer]) {
+            cerr << "ERROR::MESH::GLTF_INVALID_BUFFER_VIEW " << path << endl;
+            return;
+        }
+        this->bufferViews.push_back(v);
+    }
+
+    const Json *accessors = root.get("accessors");
+    for (size_t i = 0; accessors && i < accessors->size(); ++i) {
+        const Json &accessor = accessors->items[i];
+        const Json *type = accessor.get("type");
+        const Json *normalized = accessor.get("normalized");
+
+        GltfAccessor a;
+        a.bufferView = accessor.getInt("bufferView", -1);
+        a.componentType = accessor.getInt("componentType", 0);
+        a.components = type ? componentCount(type->text) : 0;
+        a.normalized = normalized && normalized->number != 0.0;
+        bool sizes = accessor.getSize("byteOffset", GLTF_MAX_BYTES, a.byteOffset)
+                  && accessor.getSize("count", GLTF_MAX_ELEMENTS, a.count);
+
+        // Sparse & bufferless accessors are not supported; they are rejected when used
+        if (!sizes || a.bufferView >= (int)this->bufferViews.size() || a.elementSize() == 0) {
+            a.bufferView = -1;
+        } else if (a.bufferView >= 0 && a.count > 0) {
+            const GltfBufferView &view = this->bufferViews[a.bufferView];
+            size_t stride = view.byteStride ? view.byteStride : a.elementSize();
+            if (a.byteOffset + (a.count - 1) * stride + a.elementSize() > view.byteLength) {
+                a.bufferView = -1;
+            }
+        }
+        this->accessors.push_back(a);
+    }
+
+    // Accessor index if it can be read as expected, -1 otherwise
+    auto attribute = [&](const Json &attributes, const char *name, int components, size_t count) {
+        int index = attributes.getInt(name, -1);
+        if (index < 0 || index >= (int)this->accessors.size()) {
+            return -1;
+        }
+        const GltfAccessor &a = this->accessors[index];
+        if (a.bufferView < 0 || a.components != components || (count && a.count != count)) {
+            return -1;
+        }
+        return index;
+    };
+
+    // Node transforms are not applied, vertices stay in mesh space.
+    // Primitives may share accessors, so the totals are bounded too.
+    size_t vertexTotal = 0;
+    size_t indexTotal = 0;
+    const Json *meshes = root.get("meshes");
+    for (size_t m = 0; meshes && m < meshes->size(); ++m) {
+        const Json *primitives = meshes->items[m].get("primitives");
+        for (size_t i = 0; primitives && i < primitives->size(); ++i) {
+            const Json &primitive = primitives->items[i];
+            const Json *attributes = primitive.get("attributes");
+            // Triangle lists only
+            if (!attributes || primitive.getInt("mode", 4) != 4) {
+                continue;
+            }
+
+            GltfPrimitive p;
+            p.position = attribute(*attributes, "POSITION", 3, 0);
+            if (p.position < 0 || this->accessors[p.position].componentType != GL_FLOAT) {
+                continue;
+            }
+            size_t count = this->accessors[p.position].count;
+            if (count == 0) {
+                continue;
+            }
+            p.texcoord = attribute(*attributes, "TEXCOORD_0", 2, count);
+            p.normal = attribute(*attributes, "NORMAL", 3, count);
+
+            p.indices = primitive.getInt("indices", -1);
+            if (p.indices >= (int)this->accessors.size()) {
+                continue;
+            }
+            if (p.indices >= 0) {
+                const GltfAccessor &a = this->accessors[p.indices];
+                if (a.bufferView < 0 || a.components != 1 || a.componentType == GL_FLOAT
+                        || a.componentType == GL_BYTE || a.componentType == GL_SHORT) {
+                    continue;
+                }
+            }
+
+            vertexTotal += count;
+            indexTotal += p.indices >= 0 ? this->accessors[p.indices].count : count;
+            if (vertexTotal > GLTF_MAX_ELEMENTS || indexTotal > GLTF_MAX_ELEMENTS) {
+                cerr << "ERROR::MESH::GLTF_TOO_LARGE " << path << endl;
+                return;
+            }
+            this->primitives.push_back(p);
+        }
+    }
+
+    this->loaded = true;
+}
+
+GltfFile::~GltfFile() {
+    for (MappedFile *file : this->files) {
+        delete file;
+    }
+}
+
+const unsigned char *GltfFile::accessorData(int accessor) const {
+    const GltfAccessor &a = this->accessors[accessor];
+    const GltfBufferView &view = this->bufferViews[a.bufferView];
+    return this->buffers[view.buffer] + view.byteOffset + a.byteOffset;
+}
+
+size_t GltfFile::accessorStride(int accessor) const {
+    const GltfAccessor &a = this->accessors[accessor];
+    const GltfBufferView &view = this->bufferViews[a.bufferView];
+    return view.byteStride ? view.byteStride : a.elementSize();
+}
+
+void GltfFile::toMesh(Mesh &mesh, JobSystem &jobs) const {
+    const size_t GRAIN = 16384;
+    const unsigned stride = LOADED_MESH_STRIDE;
+
+    mesh.stride = stride;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+
+    for (const GltfPrimitive &p : this->primitives) {
+        const GltfAccessor &positions = this->accessors[p.position];
+        size_t base = mesh.vertexCount();
+        size_t count = positions.count;
+        mesh.vertices.resize((base + count) * stride, 0.f);
+
+        // Source attribute, offset in the vertex & component count
+        const int sources[3][3] = { { p.position, 0, 3 }, { p.texcoord, 3, 2 }, { p.normal, 5, 3 } };
+        for (const auto &source : sources) {
+            if (source[0] < 0) {
+                continue;
+            }
+            const GltfAccessor &a = this->accessors[source[0]];
+            const unsigned char *data = this->accessorData(source[0]);
+            size_t sourceStride = this->accessorStride(source[0]);
+            size_t size = componentSize(a.componentType);
+
+            jobs.parallelFor(0, count, GRAIN, [&](size_t from, size_t to) {
+                for (size_t v = from; v < to; ++v) {
+                    float *dst = &mesh.vertices[(base + v) * stride + source[1]];
+                    const unsigned char *src = data + v * sourceStride;
+                    for (int k = 0; k < source[2]; ++k) {
+                        dst[k] = readComponent(src + k * size, a.componentType, a.normalized);
+                    }
+                }
+            });
+        }
+
+        // Out of range indices are clamped rather than trusted
+        size_t first = mesh.indices.size();
+        if (p.indices < 0) {
+            for (size_t v = 0; v < count; ++v) {
+                mesh.indices.push_back(base + v);
+            }
+        } else {
+            const GltfAccessor &a = this->accessors[p.indices];
+            const unsigned char *data = this->accessorData(p.indices);
+            size_t sourceStride = this->accessorStride(p.indices);
+            size_t triangles = a.count / 3;
+            mesh.indices.resize(first + triangles * 3);
+
+            jobs.parallelFor(0, triangles * 3, GRAIN, [&](size_t from, size_t to) {
+                for (size_t i = from; i < to; ++i) {
+                    unsigned index = readIndex(data + i * sourceStride, a.componentType);
+                    mesh.indices[first + i] = base + min((size_t)index, count - 1);
+                }
+            });
+        }
+    }
+}
+
+bool loadGltf(const char *path, Mesh &mesh, JobSystem &jobs) {
+    GltfFile file(path);
+    if (!file.loaded) {
+        return false;
+    }
+    if (file.primitives.empty()) {
+        cerr << "ERROR::MESH::GLTF_NO_TRIANGLES " << path << endl;
+        return false;
+    }
+    file.toMesh(mesh, jobs);
+    return true;
+}
+
+static bool hasExtension(const string &path, const char *extension) {
+    size_t n = strlen(extension);
+    return path.size() >= n && strcasecmp(path.c_str() + path.size() - n, extension) == 0;
+}
+
+bool loadMesh(const char *path, Mesh &mesh, JobSystem &jobs) {
+    if (hasExtension(path, ".obj")) {
+        return loadObj(path, mesh, jobs);
+    }
+    if (hasExtension(path, ".gltf") || hasExtension(path, ".glb")) {
+        return loadGltf(path, mesh, jobs);
+    }
+    cerr << "ERROR::MESH::UNKNOWN_FORMAT " << path << endl;
+    return false;
+}
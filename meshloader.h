@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "context.h"
+#include "jobs.h"
+#include "mesh.h"
+
+// Loaded meshes have position, texture coordinates & normal per vertex;
+// attributes missing from the file are zero
+const unsigned LOADED_MESH_STRIDE = 8;
+
+// Read-only memory mapped file
+struct MappedFile {
+    const unsigned char *data;
+    size_t size;
+
+    MappedFile(const char *path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    bool valid() const { return this->data != NULL; }
+
+    // Drops pages of [offset, offset + length) from memory; touching them reads them in again
+    void release(size_t offset, size_t length) const;
+};
+
+// Wavefront OBJ. The file is parsed in parallel chunks, a batch of chunks at
+// a time, so only a batch of text is resident however big the file is.
+// Polygons are triangulated as fans and identical position/uv/normal
+// triples are merged.
+bool loadObj(const char *path, Mesh &mesh, JobSystem &jobs);
+
+struct GltfBufferView {
+    int buffer;
+    size_t byteOffset;
+    size_t byteLength;
+    size_t byteStride;  // 0 if tightly packed
+};
+
+struct GltfAccessor {
+    int bufferView;
+    size_t byteOffset;  // Inside the buffer view
+    GLenum componentType;
+    int components;
+    size_t count;
+    bool normalized;
+
+    size_t elementSize() const;
+};
+
+// Accessor indices of a triangle primitive, -1 if missing
+struct GltfPrimitive {
+    int position;
+    int texcoord;
+    int normal;
+    int indices;
+};
+
+// glTF 2.0, either .gltf with external .bin buffers or .glb. Buffers stay
+// memory mapped and are read in place while converting to a Mesh. Counts
+// and sizes in the JSON are bounded, and out of range ones rejected.
+struct GltfFile {
+    std::vector<MappedFile*> files;
+    std::vector<const unsigned char*> buffers;
+    std::vector<size_t> bufferSizes;
+    std::vector<GltfBufferView> bufferViews;
+    std::vector<GltfAccessor> accessors;
+    std::vector<GltfPrimitive> primitives;  // Of all meshes
+    bool loaded;
+
+    GltfFile(const char *path);
+    ~GltfFile();
+
+    GltfFile(const GltfFile&) = delete;
+    GltfFile &operator=(const GltfFile&) = delete;
+
+    const unsigned char *accessorData(int accessor) const;
+    size_t accessorStride(int accessor) const;
+
+    // Interleaves all primitives into one mesh in LOADED_MESH_STRIDE layout
+    void toMesh(Mesh &mesh, JobSystem &jobs) const;
+};
+
+bool loadGltf(const char *path, Mesh &mesh, JobSystem &jobs);
+
+// Picks the loader by file extension
+bool loadMesh(const char *path, Mesh &mesh, JobSystem &jobs);
@@ -0,0 +1,336 @@
+#include "meshopt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// Stats
+
+VertexCacheStats analyzeVertexCache(const unsigned *indices, size_t indexCount,
+        size_t vertexCount, unsigned cacheSize) {
+    VertexCacheStats stats;
+    stats.transformed = 0;
+
+    // Timestamp when each vertex entered the FIFO
+    vector<size_t> entered(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    vector<char> used(vertexCount, 0);
+    size_t unique = 0;
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        unsigned v = indices[i];
+        if (time - entered[v] > cacheSize) {
+            entered[v] = time++;
+            ++stats.transformed;
+        }
+        if (!used[v]) {
+            used[v] = 1;
+            ++unique;
+        }
+    }
+
+    size_t triangles = indexCount / 3;
+    stats.acmr = triangles ? float(stats.transformed) / triangles : 0.f;
+    stats.atvr = unique ? float(stats.transformed) / unique : 0.f;
+    return stats;
+}
+
+// Vertex cache
+
+namespace {
+
+const int CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cachePosition, unsigned remaining) {
+    if (remaining == 0) {
+        return -1.f;
+    }
+
+    float score = 0.f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // Used by the last triangle: fixed score so it isn't reused right away
+            score = LAST_TRIANGLE_SCORE;
+        } else {
+            float scale = 1.f / (CACHE_SIZE - 3);
+            score = powf(1.f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+
+    // Prefer vertices with few triangles left, to finish them off
+    return score + VALENCE_BOOST_SCALE * powf((float)remaining, -VALENCE_BOOST_POWER);
+}
+
+}
+
+void optimizeVertexCache(unsigned *dst, const unsigned *indices, size_t indexCount, size_t vertexCount) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles adjacent to each vertex
+    vector<unsigned> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        ++remaining[indices[i]];
+    }
+    vector<unsigned> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    vector<unsigned> adjacency(triangleCount * 3);
+    vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    vector<float> vScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vScore[v] = vertexScore(-1, remaining[v]);
+    }
+
+    vector<char> emitted(triangleCount, 0);
+    vector<unsigned> cache;
+    cache.reserve(CACHE_SIZE + 3);
+    vector<unsigned> newCache;
+    newCache.reserve(CACHE_SIZE + 3);
+
+    size_t cursor = 0;  // For picking a fresh triangle when the cache has nothing to offer
+    long best = -1;
+
+    for (size_t output = 0; output < triangleCount; ++output) {
+        if (best < 0) {
+            while (emitted[cursor]) {
+                ++cursor;
+            }
+            best = cursor;
+        }
+
+        // Emit
+        const unsigned *tri = &indices[best * 3];
+        dst[output * 3 + 0] = tri[0];
+        dst[output * 3 + 1] = tri[1];
+        dst[output * 3 + 2] = tri[2];
+        emitted[best] = 1;
+
+        // Remove triangle from adjacency of its vertices
+        for (int k = 0; k < 3; ++k) {
+            unsigned v = tri[k];
+            unsigned *begin = &adjacency[offsets[v]];
+            unsigned *end = begin + remaining[v];
+            unsigned *it = find(begin, end, (unsigned)best);
+            *it = *(end - 1);
+            --remaining[v];
+        }
+
+        // Triangle's vertices go to the front of the LRU cache
+        newCache.assign(tri, tri + 3);
+        for (unsigned v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                newCache.push_back(v);
+            }
+        }
+        cache.swap(newCache);
+
+        // Rescore vertices in cache, including ones pushed out
+        for (size_t i = 0; i < cache.size(); ++i) {
+            unsigned v = cache[i];
+            vScore[v] = vertexScore(i < (size_t)CACHE_SIZE ? (int)i : -1, remaining[v]);
+        }
+
+        // Rescore their triangles and pick the best for the next step
+        best = -1;
+        float bestScore = -1.f;
+        for (unsigned v : cache) {
+            for (unsigned a = 0; a < remaining[v]; ++a) {
+                unsigned t = adjacency[offsets[v] + a];
+                const unsigned *tv = &indices[t * 3];
+                float score = vScore[tv[0]] + vScore[tv[1]] + vScore[tv[2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        if (cache.size() > (size_t)CACHE_SIZE) {
+            cache.resize(CACHE_SIZE);
+        }
+    }
+}
+
+// Overdraw
+
+void optimizeOverdraw(unsigned *dst, const unsigned *indices, size_t indexCount,
+        const float *vertices, size_t stride, size_t vertexCount, float threshold) {
+    const unsigned FIFO_SIZE = 16;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Simulates FIFO cache, returns misses of triangle t
+    vector<size_t> entered(vertexCount, 0);
+    size_t time = FIFO_SIZE + 1;
+    auto misses = [&](size_t t) {
+        unsigned n = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned v = indices[t * 3 + k];
+            if (time - entered[v] > FIFO_SIZE) {
+                entered[v] = time++;
+                ++n;
+            }
+        }
+        return n;
+    };
+    auto resetCache = [&]() { time += FIFO_SIZE + 1; };
+
+    // Hard boundaries: triangles where the whole cache missed
+    vector<size_t> hard(1, 0);
+    misses(0);
+    for (size_t t = 1; t < triangleCount; ++t) {
+        if (misses(t) == 3) {
+            hard.push_back(t);
+        }
+    }
+    hard.push_back(triangleCount);
+
+    // Soft boundaries: split clusters further while efficiency stays within threshold
+    vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        size_t begin = hard[h], end = hard[h + 1];
+
+        resetCache();
+        size_t clusterMisses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            clusterMisses += misses(t);
+        }
+        float limit = threshold * clusterMisses / (end - begin);
+
+        resetCache();
+        clusters.push_back(begin);
+        size_t start = begin;
+        size_t running = 0;
+        for (size_t t = begin; t < end; ++t) {
+            running += misses(t);
+            if (t + 1 < end && float(running) / (t - start + 1) <= limit) {
+                clusters.push_back(t + 1);
+                start = t + 1;
+                running = 0;
+                resetCache();
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Mesh centroid
+    float meshCenter[3] = { 0.f, 0.f, 0.f };
+    for (size_t v = 0; v < vertexCount; ++v) {
+        for (int k = 0; k < 3; ++k) {
+            meshCenter[k] += vertices[v * stride + k] / vertexCount;
+        }
+    }
+
+    // Sort key: how much the cluster faces away from the center
+    size_t clusterCount = clusters.size() - 1;
+    vector<float> keys(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float center[3] = { 0.f, 0.f, 0.f };
+        float normal[3] = { 0.f, 0.f, 0.f };
+        float area = 0.f;
+
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+            const float *p0 = &vertices[indices[t * 3 + 0] * stride];
+            const float *p1 = &vertices[indices[t * 3 + 1] * stride];
+            const float *p2 = &vertices[indices[t * 3 + 2] * stride];
+
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+                           e1[2] * e2[0] - e1[0] * e2[2],
+                           e1[0] * e2[1] - e1[1] * e2[0] };
+            float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int k = 0; k < 3; ++k) {
+                center[k] += (p0[k] + p1[k] + p2[k]) / 3.f * a;
+                normal[k] += n[k];
+            }
+            area += a;
+        }
+
+        float len = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        keys[c] = 0.f;
+        if (area > 0.f && len > 0.f) {
+            for (int k = 0; k < 3; ++k) {
+                keys[c] += (center[k] / area - meshCenter[k]) * normal[k] / len;
+            }
+        }
+    }
+
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        order[c] = c;
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    size_t out = 0;
+    for (size_t c : order) {
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+            dst[out++] = indices[t * 3 + 0];
+            dst[out++] = indices[t * 3 + 1];
+            dst[out++] = indices[t * 3 + 2];
+        }
+    }
+}
+
+// Vertex fetch
+
+size_t optimizeVertexFetch(float *dst, unsigned *indices, size_t indexCount,
+        const float *vertices, size_t stride, size_t vertexCount) {
+    const unsigned UNUSED = ~0u;
+    vector<unsigned> remap(vertexCount, UNUSED);
+
+    size_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        unsigned v = indices[i];
+        if (remap[v] == UNUSED) {
+            remap[v] = next;
+            copy(vertices + v * stride, vertices + (v + 1) * stride, dst + next * stride);
+            ++next;
+        }
+        indices[i] = remap[v];
+    }
+    return next;
+}
+
+// Everything
+
+MeshOptimizeStats optimizeMesh(Mesh &mesh) {
+    MeshOptimizeStats stats;
+    size_t vertexCount = mesh.vertexCount();
+    size_t indexCount = mesh.indices.size();
+
+    stats.before = analyzeVertexCache(mesh.indices.data(), indexCount, vertexCount);
+
+    vector<unsigned> cacheOptimized(indexCount);
+    optimizeVertexCache(cacheOptimized.data(), mesh.indices.data(), indexCount, vertexCount);
+    optimizeOverdraw(mesh.indices.data(), cacheOptimized.data(), indexCount,
+            mesh.vertices.data(), mesh.stride, vertexCount);
+
+    vector<float> vertices(mesh.vertices.size());
+    size_t used = optimizeVertexFetch(vertices.data(), mesh.indices.data(), indexCount,
+            mesh.vertices.data(), mesh.stride, vertexCount);
+    vertices.resize(used * mesh.stride);
+    mesh.vertices.swap(vertices);
+
+    stats.after = analyzeVertexCache(mesh.indices.data(), indexCount, mesh.vertexCount());
+    return stats;
+}
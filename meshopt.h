@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+#include "mesh.h"
+
+// Post-transform vertex cache efficiency of an index buffer, simulated
+// with a FIFO cache as found in most GPUs
+struct VertexCacheStats {
+    size_t transformed;  // Vertex shader invocations
+    float acmr;          // Average cache miss ratio: transformed per triangle (0.5 is ideal)
+    float atvr;          // Average transformed vertex ratio: transformed per vertex (1 is ideal)
+};
+
+VertexCacheStats analyzeVertexCache(const unsigned *indices, size_t indexCount,
+        size_t vertexCount, unsigned cacheSize = 16);
+
+// Forsyth's linear-speed vertex cache optimization. Dst must not alias indices.
+void optimizeVertexCache(unsigned *dst, const unsigned *indices, size_t indexCount, size_t vertexCount);
+
+// Splits a cache-optimized index buffer into clusters at cache flushes and
+// orders clusters front-facing-outwards first to reduce overdraw, giving up
+// at most threshold times the cache efficiency inside each cluster.
+// Dst must not alias indices.
+void optimizeOverdraw(unsigned *dst, const unsigned *indices, size_t indexCount,
+        const float *vertices, size_t stride, size_t vertexCount, float threshold = 1.05f);
+
+// Reorders vertices in order of first use, dropping unused ones, and
+// rewrites indices in place. Returns the new vertex count.
+size_t optimizeVertexFetch(float *dst, unsigned *indices, size_t indexCount,
+        const float *vertices, size_t stride, size_t vertexCount);
+
+// Runs all of the above on mesh
+struct MeshOptimizeStats {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+MeshOptimizeStats optimizeMesh(Mesh &mesh);
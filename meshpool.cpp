@@ -0,0 +1,165 @@
+#include "meshpool.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "indexbuffer.h"
+
+using namespace std;
+
+// GPU heap
+
+GpuHeap::GpuHeap(size_t elementSize, size_t capacity, GLenum usage)
+        : buffer(BufferHandle::create()), elementSize(elementSize), usage(usage), allocator(capacity) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity * elementSize, NULL, usage);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+uint32_t GpuHeap::allocate(size_t count) {
+    uint32_t block = this->allocator.allocate(count);
+    if (block == TlsfAllocator::INVALID) {
+        // Whatever free space ends the range joins the new tail, which alone is large enough
+        this->grow(max<size_t>(this->allocator.capacity * 2, this->allocator.capacity + TlsfAllocator::roundUp(count)));
+        block = this->allocator.allocate(count);
+    }
+    return block;
+}
+
+void GpuHeap::free(uint32_t block) {
+    this->allocator.free(block);
+}
+
+void GpuHeap::upload(uint32_t block, const void *data, size_t count) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, this->offset(block) * this->elementSize, count * this->elementSize, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GpuHeap::grow(size_t capacity) {
+    size_t old = this->allocator.capacity * this->elementSize;
+    this->allocator.grow(capacity);
+
+    BufferHandle temporary = BufferHandle::create();
+    glBindBuffer(GL_COPY_READ_BUFFER, this->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, temporary);
+    glBufferData(GL_COPY_WRITE_BUFFER, old, NULL, GL_STREAM_COPY);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, temporary);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity * this->elementSize, NULL, this->usage);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+bool GpuHeap::defragment() {
+    vector<TlsfAllocator::Move> moves = this->allocator.defragment();
+    if (moves.empty()) {
+        return false;
+    }
+
+    // Moved ranges may overlap their old place, so the packed front is
+    // assembled in a temporary buffer and copied back in one go
+    size_t used = this->allocator.used * this->elementSize;
+    BufferHandle temporary = BufferHandle::create();
+    glBindBuffer(GL_COPY_READ_BUFFER, this->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, temporary);
+    glBufferData(GL_COPY_WRITE_BUFFER, used, NULL, GL_STREAM_COPY);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    for (const auto &move : moves) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                move.from * this->elementSize, move.to * this->elementSize, move.size * this->elementSize);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, temporary);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return true;
+}
+
+// Mesh pool
+
+MeshPool::MeshPool(const VertexFormat &format, GLenum indexType, size_t vertexCapacity, size_t indexCapacity)
+        : format(format), indexType(indexType), vao(VertexArrayHandle::create()),
+          vertices(format.stride, vertexCapacity), indices(indexSize(indexType), indexCapacity) {
+    glBindVertexArray(this->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, this->vertices.buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indices.buffer);
+        this->format.apply();
+    glBindVertexArray(0);
+}
+
+int MeshPool::add(const void *vertices, size_t vertexCount, const void *indices, GLenum type, size_t indexCount) {
+    // Indices are stored relative to the mesh's base vertex, in the pool's type
+    vector<unsigned char> converted;
+    if (type != this->indexType) {
+        if (indexSize(::indexType(vertexCount)) > indexSize(this->indexType)) {
+            cerr << "ERROR::MESH_POOL::INDEX_TYPE_TOO_SMALL" << endl;
+            return -1;
+        }
+        vector<unsigned> wide(indexCount);
+        unpackIndices(indices, type, indexCount, wide.data());
+        converted.resize(indexCount * indexSize(this->indexType));
+        for (size_t i = 0; i < indexCount; ++i) {
+            switch (this->indexType) {
+                case GL_UNSIGNED_BYTE:  converted[i] = wide[i]; break;
+                case GL_UNSIGNED_SHORT: ((unsigned short*)converted.data())[i] = wide[i]; break;
+                default:                ((unsigned*)converted.data())[i] = wide[i]; break;
+            }
+        }
+        indices = converted.data();
+    }
+
+    PooledMesh mesh;
+    mesh.vertexBlock = this->vertices.allocate(vertexCount);
+    mesh.indexBlock = this->indices.allocate(indexCount);
+    mesh.indexCount = indexCount;
+    if (mesh.vertexBlock == TlsfAllocator::INVALID || mesh.indexBlock == TlsfAllocator::INVALID) {
+        if (mesh.vertexBlock != TlsfAllocator::INVALID) {
+            this->vertices.free(mesh.vertexBlock);
+        }
+        if (mesh.indexBlock != TlsfAllocator::INVALID) {
+            this->indices.free(mesh.indexBlock);
+        }
+        cerr << "ERROR::MESH_POOL::OUT_OF_SPACE" << endl;
+        return -1;
+    }
+    this->vertices.upload(mesh.vertexBlock, vertices, vertexCount);
+    this->indices.upload(mesh.indexBlock, indices, indexCount);
+
+    if (!this->unusedMeshes.empty()) {
+        unsigned id = this->unusedMeshes.back();
+        this->unusedMeshes.pop_back();
+        this->meshes[id] = mesh;
+        return id;
+    }
+    this->meshes.push_back(mesh);
+    return this->meshes.size() - 1;
+}
+
+void MeshPool::remove(unsigned mesh) {
+    this->vertices.free(this->meshes[mesh].vertexBlock);
+    this->indices.free(this->meshes[mesh].indexBlock);
+    this->unusedMeshes.push_back(mesh);
+}
+
+bool MeshPool::defragment() {
+    bool moved = this->vertices.defragment();
+    return this->indices.defragment() || moved;
+}
+
+void MeshPool::printStats() const {
+    TlsfAllocator::Stats v = this->vertices.allocator.stats();
+    TlsfAllocator::Stats i = this->indices.allocator.stats();
+    cout << "Mesh pool: " << this->meshes.size() - this->unusedMeshes.size() << " meshes, vertices "
+         << v.used * this->vertices.elementSize / 1024 << "/" << v.capacity * this->vertices.elementSize / 1024
+         << " KiB (fragmentation " << v.fragmentation() << "), indices "
+         << i.used * this->indices.elementSize / 1024 << "/" << i.capacity * this->indices.elementSize / 1024
+         << " KiB (fragmentation " << i.fragmentation() << ")" << endl;
+}
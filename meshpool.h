@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "context.h"
+#include "glhandle.h"
+#include "tlsf.h"
+#include "vertexformat.h"
+
+// GL buffer carved into ranges of fixed size elements by a TlsfAllocator.
+// The buffer name never changes, growing and defragmenting copy through
+// a temporary buffer, so VAOs pointing at it stay valid.
+struct GpuHeap {
+    BufferHandle buffer;
+    size_t elementSize;  // Bytes
+    GLenum usage;
+    TlsfAllocator allocator;
+
+    GpuHeap(size_t elementSize, size_t capacity, GLenum usage = GL_STATIC_DRAW);
+
+    // Block of count elements, INVALID if none fits even after growing;
+    // doubles the buffer when it is full
+    uint32_t allocate(size_t count);
+    void free(uint32_t block);
+
+    // First element of block
+    size_t offset(uint32_t block) const { return this->allocator.offset(block); }
+
+    void upload(uint32_t block, const void *data, size_t count);
+
+    void grow(size_t capacity);
+
+    // Packs blocks to the front; returns whether any moved
+    bool defragment();
+};
+
+// Draw parameters of a mesh in a MeshPool
+struct PooledMesh {
+    uint32_t vertexBlock;
+    uint32_t indexBlock;
+    size_t indexCount;
+};
+
+// Meshes sharing one vertex format and index type, sub-allocated from one
+// vertex and one index buffer behind a single VAO. Each mesh is drawn
+// with firstIndex() and baseVertex() offsets.
+//
+// Quantized positions are restored with the format's bounds uniforms,
+// so meshes with different bounds need them set per draw.
+struct MeshPool {
+    VertexFormat format;
+    GLenum indexType;
+    VertexArrayHandle vao;
+    GpuHeap vertices;
+    GpuHeap indices;
+    std::vector<PooledMesh> meshes;
+    std::vector<unsigned> unusedMeshes;
+
+    MeshPool(const VertexFormat &format, GLenum indexType, size_t vertexCapacity, size_t indexCapacity);
+
+    // Packed vertices in format & indices of any type that fits indexType.
+    // Returns the mesh id, or -1 if the indices or the mesh do not fit.
+    int add(const void *vertices, size_t vertexCount, const void *indices, GLenum type, size_t indexCount);
+    void remove(unsigned mesh);
+
+    GLint baseVertex(unsigned mesh) const { return this->vertices.offset(this->meshes[mesh].vertexBlock); }
+    GLuint firstIndex(unsigned mesh) const { return this->indices.offset(this->meshes[mesh].indexBlock); }
+
+    // Meshes' offsets change, draws built from them must be rebuilt
+    bool defragment();
+
+    void printStats() const;
+};
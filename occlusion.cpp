@@ -0,0 +1,233 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+using namespace std;
+
+// Clip-space w below which geometry is treated as crossing the camera plane
+static const float MIN_W = 1e-4f;
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) {
+    this->width = width;
+    this->height = height;
+    this->tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+    this->tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+    this->depth.resize(width * height);
+    this->tileMax.resize(this->tilesX * this->tilesY);
+    this->bins.resize(this->tilesX * this->tilesY);
+    this->clear();
+}
+
+void OcclusionBuffer::clear() {
+    fill(this->depth.begin(), this->depth.end(), 1.f);
+    fill(this->tileMax.begin(), this->tileMax.end(), 1.f);
+    this->triangles.clear();
+    for (auto &bin : this->bins) {
+        bin.clear();
+    }
+}
+
+static void project(const float *m, const float *p, float out[4]) {
+    for (int r = 0; r < 4; ++r) {
+        out[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+    }
+}
+
+void OcclusionBuffer::addOccluder(const float *mvp, const float *positions, size_t stride,
+        const unsigned *indices, size_t indexCount) {
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        float screen[3][3];
+        bool behind = false;
+        for (int v = 0; v < 3; ++v) {
+            float clip[4];
+            project(mvp, positions + indices[t + v] * stride, clip);
+            if (clip[3] < MIN_W) {
+                behind = true;
+                break;
+            }
+            screen[v][0] = (clip[0] / clip[3] * 0.5f + 0.5f) * this->width;
+            screen[v][1] = (clip[1] / clip[3] * 0.5f + 0.5f) * this->height;
+            screen[v][2] = clip[2] / clip[3] * 0.5f + 0.5f;
+        }
+        // Dropping an occluder is always safe
+        if (behind) {
+            continue;
+        }
+
+        float minX = min(screen[0][0], min(screen[1][0], screen[2][0]));
+        float maxX = max(screen[0][0], max(screen[1][0], screen[2][0]));
+        float minY = min(screen[0][1], min(screen[1][1], screen[2][1]));
+        float maxY = max(screen[0][1], max(screen[1][1], screen[2][1]));
+        if (maxX < 0.f || maxY < 0.f || minX >= this->width || minY >= this->height) {
+            continue;
+        }
+
+        int tx0 = max(0, (int)minX / TILE_WIDTH);
+        int ty0 = max(0, (int)minY / TILE_HEIGHT);
+        int tx1 = min(this->tilesX - 1, (int)maxX / TILE_WIDTH);
+        int ty1 = min(this->tilesY - 1, (int)maxY / TILE_HEIGHT);
+
+        unsigned index = this->triangles.size() / 9;
+        this->triangles.insert(this->triangles.end(), &screen[0][0], &screen[0][0] + 9);
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                this->bins[ty * this->tilesX + tx].push_back(index);
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::rasterize(JobSystem &jobs) {
+    jobs.parallelFor(0, this->tilesX * this->tilesY, 1, [this](size_t from, size_t to) {
+        for (size_t tile = from; tile < to; ++tile) {
+            this->rasterizeTile(tile);
+        }
+    });
+}
+
+void OcclusionBuffer::rasterizeTile(int tile) {
+    int tileX0 = tile % this->tilesX * TILE_WIDTH;
+    int tileY0 = tile / this->tilesX * TILE_HEIGHT;
+    int tileX1 = min(tileX0 + TILE_WIDTH, this->width);
+    int tileY1 = min(tileY0 + TILE_HEIGHT, this->height);
+
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+
+    for (unsigned index : this->bins[tile]) {
+        const float *tri = &this->triangles[index * 9];
+        float x0 = tri[0], y0 = tri[1], z0 = tri[2];
+        float x1 = tri[3], y1 = tri[4], z1 = tri[5];
+        float x2 = tri[6], y2 = tri[7], z2 = tri[8];
+
+        float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+        if (area == 0.f) {
+            continue;
+        }
+        // Both windings are rasterized
+        if (area < 0.f) {
+            swap(x1, x2);
+            swap(y1, y2);
+            swap(z1, z2);
+            area = -area;
+        }
+
+        // Edge functions e = a * x + b * y + c, positive inside
+        float ea[3] = { -(y1 - y0), -(y2 - y1), -(y0 - y2) };
+        float eb[3] = {  (x1 - x0),  (x2 - x1),  (x0 - x2) };
+        float ec[3] = { -ea[0] * x0 - eb[0] * y0,
+                        -ea[1] * x1 - eb[1] * y1,
+                        -ea[2] * x2 - eb[2] * y2 };
+
+        // Depth plane
+        float dzdx = ((z1 - z0) * (y2 - y0) - (z2 - z0) * (y1 - y0)) / area;
+        float dzdy = ((z2 - z0) * (x1 - x0) - (z1 - z0) * (x2 - x0)) / area;
+        float dzc = z0 - dzdx * x0 - dzdy * y0;
+
+        // Bounding box inside the tile, x aligned to 4 pixels
+        int minX = max(tileX0, (int)floorf(min(x0, min(x1, x2)))) & ~3;
+        int maxX = min(tileX1 - 1, (int)ceilf(max(x0, max(x1, x2))));
+        int minY = max(tileY0, (int)floorf(min(y0, min(y1, y2))));
+        int maxY = min(tileY1 - 1, (int)ceilf(max(y0, max(y1, y2))));
+
+        __m128 a[3], step[3];
+        for (int k = 0; k < 3; ++k) {
+            a[k] = _mm_set1_ps(ea[k]);
+            step[k] = _mm_set1_ps(ea[k] * 4.f);
+        }
+        __m128 zStep = _mm_set1_ps(dzdx * 4.f);
+
+        for (int y = minY; y <= maxY; ++y) {
+            float py = y + 0.5f;
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)minX), offsets);
+
+            __m128 e[3];
+            for (int k = 0; k < 3; ++k) {
+                e[k] = _mm_add_ps(_mm_mul_ps(a[k], px), _mm_set1_ps(eb[k] * py + ec[k]));
+            }
+            __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(dzdy * py + dzc));
+
+            float *row = &this->depth[y * this->width];
+            for (int x = minX; x <= maxX; x += 4) {
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(e[0], zero),
+                                _mm_and_ps(_mm_cmpge_ps(e[1], zero), _mm_cmpge_ps(e[2], zero)));
+                if (_mm_movemask_ps(inside)) {
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(old, _mm_max_ps(zero, _mm_min_ps(z, one)));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+
+                for (int k = 0; k < 3; ++k) {
+                    e[k] = _mm_add_ps(e[k], step[k]);
+                }
+                z = _mm_add_ps(z, zStep);
+            }
+        }
+    }
+
+    float farthest = 0.f;
+    for (int y = tileY0; y < tileY1; ++y) {
+        for (int x = tileX0; x < tileX1; ++x) {
+            farthest = max(farthest, this->depth[y * this->width + x]);
+        }
+    }
+    this->tileMax[tile] = farthest;
+}
+
+bool OcclusionBuffer::testBox(const float *viewProjection, const float center[3], const float extent[3]) const {
+    float minX = this->width, maxX = -1.f;
+    float minY = this->height, maxY = -1.f;
+    float nearest = 1.f;
+    for (int i = 0; i < 8; ++i) {
+        float corner[3] = {
+            center[0] + ((i & 1) ? extent[0] : -extent[0]),
+            center[1] + ((i & 2) ? extent[1] : -extent[1]),
+            center[2] + ((i & 4) ? extent[2] : -extent[2]),
+        };
+        float clip[4];
+        project(viewProjection, corner, clip);
+        if (clip[3] < MIN_W) {
+            return true;
+        }
+
+        float x = (clip[0] / clip[3] * 0.5f + 0.5f) * this->width;
+        float y = (clip[1] / clip[3] * 0.5f + 0.5f) * this->height;
+        minX = min(minX, x);
+        maxX = max(maxX, x);
+        minY = min(minY, y);
+        maxY = max(maxY, y);
+        nearest = min(nearest, clip[2] / clip[3] * 0.5f + 0.5f);
+    }
+
+    if (maxX < 0.f || maxY < 0.f || minX >= this->width || minY >= this->height) {
+        return false;
+    }
+
+    int x0 = max(0, (int)minX), x1 = min(this->width - 1, (int)maxX);
+    int y0 = max(0, (int)minY), y1 = min(this->height - 1, (int)maxY);
+
+    for (int ty = y0 / TILE_HEIGHT; ty <= y1 / TILE_HEIGHT; ++ty) {
+        for (int tx = x0 / TILE_WIDTH; tx <= x1 / TILE_WIDTH; ++tx) {
+            // Whole tile is nearer than the box
+            if (this->tileMax[ty * this->tilesX + tx] < nearest) {
+                continue;
+            }
+
+            int px0 = max(x0, tx * TILE_WIDTH), px1 = min(x1, tx * TILE_WIDTH + TILE_WIDTH - 1);
+            int py0 = max(y0, ty * TILE_HEIGHT), py1 = min(y1, ty * TILE_HEIGHT + TILE_HEIGHT - 1);
+            for (int y = py0; y <= py1; ++y) {
+                const float *row = &this->depth[y * this->width];
+                for (int x = px0; x <= px1; ++x) {
+                    if (row[x] >= nearest) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
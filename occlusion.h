@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "jobs.h"
+
+// Low resolution depth buffer rasterized on the CPU from a few occluder
+// meshes, used to reject hidden objects before they are submitted.
+// Works without a GPU.
+//
+// Triangles are binned into tiles, then tiles are rasterized in parallel
+// four pixels at a time. Depth is window-space z in [0, 1], nearest wins.
+struct OcclusionBuffer {
+    static const int TILE_WIDTH = 32;
+    static const int TILE_HEIGHT = 16;
+
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+
+    std::vector<float> depth;                 // Row-major, width * height
+    std::vector<float> tileMax;               // Farthest depth per tile
+    std::vector<float> triangles;             // Screen-space x, y, z of 3 vertices each
+    std::vector<std::vector<unsigned>> bins;  // Triangles overlapping each tile
+
+    // Width must be a multiple of 4
+    OcclusionBuffer(int width = 256, int height = 128);
+
+    void clear();
+
+    // Transforms triangles by the column-major mvp and bins them.
+    // Positions are 3 floats every stride floats.
+    void addOccluder(const float *mvp, const float *positions, size_t stride,
+            const unsigned *indices, size_t indexCount);
+
+    void rasterize(JobSystem &jobs);
+
+    // false if the box is certainly hidden behind occluders
+    bool testBox(const float *viewProjection, const float center[3], const float extent[3]) const;
+
+    // Internal
+    void rasterizeTile(int tile);
+};
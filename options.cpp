@@ -0,0 +1,151 @@
+#include "options.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+const char *shadingPathName(ShadingPath path) {
+    switch (path) {
+        case SHADING_FORWARD:   return "forward";
+        case SHADING_DEFERRED:  return "deferred";
+        case SHADING_CLUSTERED: return "clustered";
+        case SHADING_PATHS:     break;
+    }
+    return "unknown";
+}
+
+static void usage(const char *program) {
+    cerr << "Usage: " << program << " [options] [mesh.obj|mesh.gltf|mesh.glb]\n"
+         << "  --vsync=off|on|adaptive  Swap interval (default on)\n"
+         << "  --fps=N                  Limit frame rate to N\n"
+         << "  --low-latency            Sample input just before rendering, don't queue frames\n"
+         << "  --idle                   Sleep until input or animation needs a redraw (space pauses)\n"
+         << "  --dynres=N               Scale resolution (50-100%) to keep GPU time within 1/N s\n"
+         << "  --lights=N               Point lights in the scene (default 64)\n"
+         << "  --shading=forward|deferred|clustered  Lighting path (default deferred)\n"
+         << "  --light-benchmark        Compare the lighting paths' GPU time at 10/100/1000/4000 lights\n"
+         << "  --no-shadow-cache        Redraw static shadow casters every frame\n"
+         << "  --capture=png|y4m        What F12 records: PNG per frame or a Y4M video (default png)\n"
+         << "  --capture-path=PREFIX    Prefix of captured files (default capture)\n"
+         << "  --capture-fps=N          Frames captured per second, repeated to keep time (default 60)\n"
+         << "  --record                 Start capturing at launch\n"
+         << "  --msaa=1|2|4|8           Multisampling on the forward & clustered paths (default 1, off)\n"
+         << "  --fxaa                   FXAA-style post-process antialiasing\n"
+         << "  --aa-benchmark           Compare the GPU time of no AA, MSAA 2x/4x/8x and FXAA" << endl;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--vsync=", 8) == 0) {
+            const char *mode = arg + 8;
+            if (strcmp(mode, "off") == 0) {
+                options.swapMode = SWAP_IMMEDIATE;
+            } else if (strcmp(mode, "on") == 0) {
+                options.swapMode = SWAP_VSYNC;
+            } else if (strcmp(mode, "adaptive") == 0) {
+                options.swapMode = SWAP_ADAPTIVE;
+            } else {
+                cerr << "ERROR::OPTIONS::BAD_VSYNC_MODE " << mode << endl;
+                usage(argv[0]);
+                return false;
+            }
+        } else if (strncmp(arg, "--fps=", 6) == 0) {
+            char *end;
+            options.fpsLimit = strtod(arg + 6, &end);
+            if (*end != '\0' || options.fpsLimit < 0.0) {
+                cerr << "ERROR::OPTIONS::BAD_FPS " << arg + 6 << endl;
+                usage(argv[0]);
+                return false;
+            }
+        } else if (strncmp(arg, "--dynres=", 9) == 0) {
+            char *end;
+            options.dynamicResolutionFps = strtod(arg + 9, &end);
+            if (*end != '\0' || options.dynamicResolutionFps <= 0.0) {
+                cerr << "ERROR::OPTIONS::BAD_FPS " << arg + 9 << endl;
+                usage(argv[0]);
+                return false;
+            }
+        } else if (strncmp(arg, "--lights=", 9) == 0) {
+            char *end;
+            long lights = strtol(arg + 9, &end, 10);
+            if (*end != '\0' || lights < 0 || lights > 65536) {
+                cerr << "ERROR::OPTIONS::BAD_LIGHT_COUNT " << arg + 9 << endl;
+                usage(argv[0]);
+                return false;
+            }
+            options.lights = int(lights);
+        } else if (strncmp(arg, "--shading=", 10) == 0) {
+            const char *path = arg + 10;
+            int p = 0;
+            while (p < SHADING_PATHS && strcmp(path, shadingPathName(ShadingPath(p))) != 0) {
+                ++p;
+            }
+            if (p == SHADING_PATHS) {
+                cerr << "ERROR::OPTIONS::BAD_SHADING_PATH " << path << endl;
+                usage(argv[0]);
+                return false;
+            }
+            options.shading = ShadingPath(p);
+        } else if (strcmp(arg, "--light-benchmark") == 0) {
+            options.lightBenchmark = true;
+        } else if (strcmp(arg, "--no-shadow-cache") == 0) {
+            options.shadowCache = false;
+        } else if (strncmp(arg, "--capture=", 10) == 0) {
+            const char *format = arg + 10;
+            if (strcmp(format, captureFormatName(CAPTURE_PNG)) == 0) {
+                options.captureFormat = CAPTURE_PNG;
+            } else if (strcmp(format, captureFormatName(CAPTURE_Y4M)) == 0) {
+                options.captureFormat = CAPTURE_Y4M;
+            } else {
+                cerr << "ERROR::OPTIONS::BAD_CAPTURE_FORMAT " << format << endl;
+                usage(argv[0]);
+                return false;
+            }
+        } else if (strncmp(arg, "--capture-path=", 15) == 0) {
+            options.capturePath = arg + 15;
+        } else if (strncmp(arg, "--capture-fps=", 14) == 0) {
+            char *end;
+            long fps = strtol(arg + 14, &end, 10);
+            if (*end != '\0' || fps <= 0 || fps > 1000) {
+                cerr << "ERROR::OPTIONS::BAD_FPS " << arg + 14 << endl;
+                usage(argv[0]);
+                return false;
+            }
+            options.captureFps = int(fps);
+        } else if (strcmp(arg, "--record") == 0) {
+            options.record = true;
+        } else if (strncmp(arg, "--msaa=", 7) == 0) {
+            char *end;
+            long samples = strtol(arg + 7, &end, 10);
+            if (*end != '\0' || (samples != 1 && samples != 2 && samples != 4 && samples != 8)) {
+                cerr << "ERROR::OPTIONS::BAD_MSAA_SAMPLES " << arg + 7 << endl;
+                usage(argv[0]);
+                return false;
+            }
+            options.msaa = int(samples);
+        } else if (strcmp(arg, "--fxaa") == 0) {
+            options.fxaa = true;
+        } else if (strcmp(arg, "--aa-benchmark") == 0) {
+            options.aaBenchmark = true;
+        } else if (strcmp(arg, "--low-latency") == 0) {
+            options.lowLatency = true;
+        } else if (strcmp(arg, "--idle") == 0) {
+            options.idle = true;
+        } else if (strncmp(arg, "--", 2) == 0 || options.meshPath) {
+            cerr << "ERROR::OPTIONS::UNKNOWN_ARGUMENT " << arg << endl;
+            usage(argv[0]);
+            return false;
+        } else {
+            options.meshPath = arg;
+        }
+    }
+    if (options.lightBenchmark && options.aaBenchmark) {
+        cerr << "ERROR::OPTIONS::ONE_BENCHMARK_AT_A_TIME" << endl;
+        usage(argv[0]);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+#include "capture.h"
+#include "framepacing.h"
+
+enum ShadingPath {
+    SHADING_FORWARD,    // Every fragment loops over all lights
+    SHADING_DEFERRED,   // G-buffer, then light volumes
+    SHADING_CLUSTERED,  // Fragments loop over their view frustum cluster's lights
+    SHADING_PATHS,
+};
+
+const char *shadingPathName(ShadingPath path);
+
+// Command line: [options] [mesh file]
+struct Options {
+    const char *meshPath;  // NULL for the built-in cube
+    SwapMode swapMode;
+    double fpsLimit;       // 0 for none
+    bool lowLatency;       // Sample input right before rendering & don't queue frames
+    bool idle;             // Redraw only when something changed, sleep otherwise
+    double dynamicResolutionFps;  // GPU frame rate to scale resolution for, 0 for fixed
+    int lights;            // Point lights scattered through the scene
+    ShadingPath shading;
+    bool lightBenchmark;   // Time each shading path at 10 to 4000 lights, then exit
+    bool shadowCache;      // Draw static shadow casters only when their cascade moves
+    CaptureFormat captureFormat;
+    const char *capturePath;  // Prefix of captured files
+    int captureFps;        // Frames captured per second of wall clock time
+    bool record;           // Start capturing right away, F12 toggles
+    int msaa;              // Samples per pixel on the forward & clustered paths, 1 for none
+    bool fxaa;             // Post-process antialiasing on the way to the window
+    bool aaBenchmark;      // Time no AA, MSAA 2x/4x/8x & FXAA, then exit
+
+    Options()
+        : meshPath(NULL), swapMode(SWAP_VSYNC), fpsLimit(0.0), lowLatency(false), idle(false),
+          dynamicResolutionFps(0.0), lights(64), shading(SHADING_DEFERRED), lightBenchmark(false),
+          shadowCache(true), captureFormat(CAPTURE_PNG), capturePath("capture"), captureFps(60), record(false),
+          msaa(1), fxaa(false), aaBenchmark(false) {}
+};
+
+// Prints usage and returns false on bad arguments
+bool parseOptions(int argc, char **argv, Options &options);
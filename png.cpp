@@ -0,0 +1,282 @@
+#include "png.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+// Checksums
+
+static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool built = false;
+    if (!built) {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        built = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t adler32(const uint8_t *data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // Largest run before the sums can overflow
+        size_t n = size < 5552 ? size : 5552;
+        size -= n;
+        for (size_t i = 0; i < n; ++i) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+// Deflate
+
+struct BitWriter {
+    vector<uint8_t> &out;
+    uint64_t bits;
+    int count;
+
+    BitWriter(vector<uint8_t> &out) : out(out), bits(0), count(0) {}
+
+    // Least significant bit first
+    void write(uint32_t value, int n) {
+        this->bits |= uint64_t(value) << this->count;
+        this->count += n;
+        while (this->count >= 8) {
+            this->out.push_back(uint8_t(this->bits));
+            this->bits >>= 8;
+            this->count -= 8;
+        }
+    }
+
+    void flush() {
+        if (this->count > 0) {
+            this->out.push_back(uint8_t(this->bits));
+        }
+        this->bits = 0;
+        this->count = 0;
+    }
+};
+
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static const int WINDOW = 32768;
+static const int MIN_MATCH = 3;
+static const int MAX_MATCH = 258;
+static const int HASH_BITS = 15;
+
+static uint32_t reverseBits(uint32_t code, int n) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < n; ++i) {
+        reversed |= (code >> i & 1) << (n - 1 - i);
+    }
+    return reversed;
+}
+
+// Fixed Huffman codes of literal/length symbols, already bit reversed
+struct FixedCodes {
+    uint16_t code[288];
+    uint8_t length[288];
+
+    FixedCodes() {
+        for (int symbol = 0; symbol < 288; ++symbol) {
+            if (symbol < 144) {
+                this->set(symbol, 0x30 + symbol, 8);
+            } else if (symbol < 256) {
+                this->set(symbol, 0x190 + symbol - 144, 9);
+            } else if (symbol < 280) {
+                this->set(symbol, symbol - 256, 7);
+            } else {
+                this->set(symbol, 0xc0 + symbol - 280, 8);
+            }
+        }
+    }
+
+    void set(int symbol, uint32_t code, int n) {
+        this->code[symbol] = reverseBits(code, n);
+        this->length[symbol] = n;
+    }
+};
+
+static const FixedCodes FIXED_CODES;
+
+static void writeSymbol(BitWriter &w, int symbol) {
+    w.write(FIXED_CODES.code[symbol], FIXED_CODES.length[symbol]);
+}
+
+static void writeMatch(BitWriter &w, int length, int distance) {
+    int l = 28;
+    while (LENGTH_BASE[l] > length) {
+        --l;
+    }
+    writeSymbol(w, 257 + l);
+    w.write(length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+
+    int d = 29;
+    while (DISTANCE_BASE[d] > distance) {
+        --d;
+    }
+    w.write(reverseBits(d, 5), 5);
+    w.write(distance - DISTANCE_BASE[d], DISTANCE_EXTRA[d]);
+}
+
+// Zlib stream of data: one final fixed Huffman block
+static void deflate(const uint8_t *data, size_t size, vector<uint8_t> &out) {
+    out.push_back(0x78);  // Deflate, 32K window
+    out.push_back(0x01);  // Fastest, no dictionary
+
+    BitWriter w(out);
+    w.write(1, 1);  // Final block
+    w.write(1, 2);  // Fixed Huffman codes
+
+    // Latest position + 1 of each 3-byte hash
+    vector<uint32_t> head(1 << HASH_BITS, 0);
+    auto hash = [&](size_t i) {
+        uint32_t v = data[i] | data[i + 1] << 8 | data[i + 2] << 16;
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        int length = 0;
+        size_t distance = 0;
+        if (i + MIN_MATCH <= size) {
+            uint32_t h = hash(i);
+            size_t candidate = head[h];
+            head[h] = i + 1;
+            if (candidate > 0 && i - (candidate - 1) <= WINDOW) {
+                size_t from = candidate - 1;
+                size_t limit = min<size_t>(MAX_MATCH, size - i);
+                while (length < int(limit) && data[from + length] == data[i + length]) {
+                    ++length;
+                }
+                distance = i - from;
+            }
+        }
+
+        if (length >= MIN_MATCH) {
+            writeMatch(w, length, distance);
+            // Later bytes of the match still become candidates
+            for (size_t k = i + 1; k < i + length && k + MIN_MATCH <= size; ++k) {
+                head[hash(k)] = k + 1;
+            }
+            i += length;
+        } else {
+            writeSymbol(w, data[i]);
+            ++i;
+        }
+    }
+    writeSymbol(w, 256);  // End of block
+    w.flush();
+
+    uint32_t adler = adler32(data, size);
+    for (int k = 3; k >= 0; --k) {
+        out.push_back(uint8_t(adler >> (k * 8)));
+    }
+}
+
+// PNG
+
+static uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Row filtered with whichever filter leaves the smallest absolute values
+static void filterRow(const uint8_t *row, const uint8_t *above, size_t bytes, uint8_t *out) {
+    static const int BPP = 3;
+    unsigned cost[5] = {};
+    for (size_t x = 0; x < bytes; ++x) {
+        int a = x >= BPP ? row[x - BPP] : 0;
+        int b = above ? above[x] : 0;
+        int c = x >= BPP && above ? above[x - BPP] : 0;
+        cost[0] += abs(int8_t(row[x]));
+        cost[1] += abs(int8_t(row[x] - a));
+        cost[2] += abs(int8_t(row[x] - b));
+        cost[4] += abs(int8_t(row[x] - paeth(a, b, c)));
+    }
+    int best = 0;
+    for (int filter : { 1, 2, 4 }) {
+        if (cost[filter] < cost[best]) {
+            best = filter;
+        }
+    }
+
+    out[0] = best;
+    for (size_t x = 0; x < bytes; ++x) {
+        int a = x >= BPP ? row[x - BPP] : 0;
+        int b = above ? above[x] : 0;
+        int c = x >= BPP && above ? above[x - BPP] : 0;
+        switch (best) {
+            case 0: out[1 + x] = row[x]; break;
+            case 1: out[1 + x] = row[x] - a; break;
+            case 2: out[1 + x] = row[x] - b; break;
+            case 4: out[1 + x] = row[x] - paeth(a, b, c); break;
+        }
+    }
+}
+
+static void writeChunk(vector<uint8_t> &out, const char *type, const uint8_t *data, size_t size) {
+    for (int k = 3; k >= 0; --k) {
+        out.push_back(uint8_t(size >> (k * 8)));
+    }
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    uint32_t crc = crc32(&out[start], out.size() - start);
+    for (int k = 3; k >= 0; --k) {
+        out.push_back(uint8_t(crc >> (k * 8)));
+    }
+}
+
+void encodePng(const uint8_t *rgb, int width, int height, bool flip, vector<uint8_t> &out) {
+    size_t stride = size_t(width) * 3;
+    vector<uint8_t> filtered((stride + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *row = rgb + stride * (flip ? height - 1 - y : y);
+        const uint8_t *above = y == 0 ? NULL : rgb + stride * (flip ? height - y : y - 1);
+        filterRow(row, above, stride, &filtered[(stride + 1) * y]);
+    }
+
+    vector<uint8_t> compressed;
+    deflate(filtered.data(), filtered.size(), compressed);
+
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    uint8_t header[13] = {
+        uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+        uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+        8,  // Bits per channel
+        2,  // RGB
+        0, 0, 0,  // Deflate, adaptive filtering, not interlaced
+    };
+    out.assign(SIGNATURE, SIGNATURE + 8);
+    writeChunk(out, "IHDR", header, sizeof(header));
+    writeChunk(out, "IDAT", compressed.data(), compressed.size());
+    writeChunk(out, "IEND", NULL, 0);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Minimal PNG encoder for 8-bit RGB images. Rows are filtered with the
+// per-row best of None/Sub/Up/Paeth, then compressed with a single
+// fixed-Huffman deflate block and greedy LZ77 matching: several times
+// faster than zlib's defaults at somewhat larger files.
+
+// Encodes rows of width * 3 bytes, top row first, or bottom row first
+// when flip is set (as glReadPixels returns them)
+void encodePng(const uint8_t *rgb, int width, int height, bool flip, std::vector<uint8_t> &out);
@@ -0,0 +1,260 @@
+#include "scene.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+const uint32_t TransformSystem::NONE;
+
+void TransformSystem::reserve(size_t count) {
+    this->parent.reserve(count);
+    this->positionX.reserve(count);
+    this->positionY.reserve(count);
+    this->positionZ.reserve(count);
+    this->rotationX.reserve(count);
+    this->rotationY.reserve(count);
+    this->rotationZ.reserve(count);
+    this->rotationW.reserve(count);
+    this->scaleX.reserve(count);
+    this->scaleY.reserve(count);
+    this->scaleZ.reserve(count);
+    this->dirty.reserve(count);
+    this->changed.reserve(count);
+    this->world.reserve(count * 16);
+    this->slotOf.reserve(count);
+    this->entityOf.reserve(count);
+    this->parentEntity.reserve(count);
+}
+
+uint32_t TransformSystem::create(uint32_t parentEntity) {
+    uint32_t entity = this->entityOf.size();
+    uint32_t slot = entity;
+
+    this->parent.push_back(parentEntity == NONE ? NONE : this->slotOf[parentEntity]);
+    this->positionX.push_back(0.f);
+    this->positionY.push_back(0.f);
+    this->positionZ.push_back(0.f);
+    this->rotationX.push_back(0.f);
+    this->rotationY.push_back(0.f);
+    this->rotationZ.push_back(0.f);
+    this->rotationW.push_back(1.f);
+    this->scaleX.push_back(1.f);
+    this->scaleY.push_back(1.f);
+    this->scaleZ.push_back(1.f);
+    this->dirty.push_back(1);
+    this->changed.push_back(0);
+    this->world.resize(this->world.size() + 16);
+    this->slotOf.push_back(slot);
+    this->entityOf.push_back(entity);
+    this->parentEntity.push_back(parentEntity);
+
+    // Appended after its parent, but possibly in the middle of the last level
+    this->unsorted = true;
+    return entity;
+}
+
+void TransformSystem::setParent(uint32_t entity, uint32_t parentEntity) {
+    this->parentEntity[entity] = parentEntity;
+    uint32_t slot = this->slotOf[entity];
+    this->parent[slot] = parentEntity == NONE ? NONE : this->slotOf[parentEntity];
+    this->dirty[slot] = 1;
+    this->unsorted = true;
+}
+
+void TransformSystem::setPosition(uint32_t entity, float x, float y, float z) {
+    uint32_t slot = this->slotOf[entity];
+    this->positionX[slot] = x;
+    this->positionY[slot] = y;
+    this->positionZ[slot] = z;
+    this->dirty[slot] = 1;
+}
+
+void TransformSystem::setRotation(uint32_t entity, float x, float y, float z, float w) {
+    uint32_t slot = this->slotOf[entity];
+    this->rotationX[slot] = x;
+    this->rotationY[slot] = y;
+    this->rotationZ[slot] = z;
+    this->rotationW[slot] = w;
+    this->dirty[slot] = 1;
+}
+
+void TransformSystem::setScale(uint32_t entity, float x, float y, float z) {
+    uint32_t slot = this->slotOf[entity];
+    this->scaleX[slot] = x;
+    this->scaleY[slot] = y;
+    this->scaleZ[slot] = z;
+    this->dirty[slot] = 1;
+}
+
+template <typename T>
+static void permute(vector<T> &values, const vector<uint32_t> &order, size_t width = 1) {
+    vector<T> sorted(values.size());
+    for (size_t s = 0; s < order.size(); ++s) {
+        copy(&values[order[s] * width], &values[order[s] * width] + width, &sorted[s * width]);
+    }
+    values.swap(sorted);
+}
+
+void TransformSystem::sort() {
+    size_t n = this->size();
+
+    // Children of each entity, in current slot order
+    vector<uint32_t> childFirst(n + 1, 0);
+    vector<uint32_t> children(n);
+    for (uint32_t e = 0; e < n; ++e) {
+        if (this->parentEntity[e] != NONE) {
+            ++childFirst[this->parentEntity[e] + 1];
+        }
+    }
+    for (uint32_t e = 0; e < n; ++e) {
+        childFirst[e + 1] += childFirst[e];
+    }
+    vector<uint32_t> next(childFirst.begin(), childFirst.end() - 1);
+    for (uint32_t s = 0; s < n; ++s) {
+        uint32_t e = this->entityOf[s];
+        if (this->parentEntity[e] != NONE) {
+            children[next[this->parentEntity[e]]++] = e;
+        }
+    }
+
+    // Breadth first from the roots: levels come out in order, and within
+    // a level siblings are together and their parents ascend, so the
+    // update streams through parents' matrices
+    vector<uint32_t> order;  // Entity per new slot
+    order.reserve(n);
+    for (uint32_t s = 0; s < n; ++s) {
+        if (this->parentEntity[this->entityOf[s]] == NONE) {
+            order.push_back(this->entityOf[s]);
+        }
+    }
+    this->levelFirst.assign(1, 0);
+    for (size_t levelBegin = 0; levelBegin < order.size(); ) {
+        size_t levelEnd = order.size();
+        this->levelFirst.push_back(levelEnd);
+        for (size_t i = levelBegin; i < levelEnd; ++i) {
+            uint32_t e = order[i];
+            order.insert(order.end(), children.begin() + childFirst[e], children.begin() + childFirst[e + 1]);
+        }
+        levelBegin = levelEnd;
+    }
+
+    // Entities on a parent cycle never reach a root: keep them as roots
+    if (order.size() < n) {
+        vector<unsigned char> placed(n, 0);
+        for (uint32_t e : order) {
+            placed[e] = 1;
+        }
+        for (uint32_t e = 0; e < n; ++e) {
+            if (!placed[e]) {
+                this->parentEntity[e] = NONE;
+                order.push_back(e);
+            }
+        }
+        this->levelFirst.push_back(n);
+    }
+
+    // Old slot per new slot
+    for (uint32_t &e : order) {
+        e = this->slotOf[e];
+    }
+
+    permute(this->positionX, order);
+    permute(this->positionY, order);
+    permute(this->positionZ, order);
+    permute(this->rotationX, order);
+    permute(this->rotationY, order);
+    permute(this->rotationZ, order);
+    permute(this->rotationW, order);
+    permute(this->scaleX, order);
+    permute(this->scaleY, order);
+    permute(this->scaleZ, order);
+    permute(this->dirty, order);
+    permute(this->changed, order);
+    permute(this->world, order, 16);
+    permute(this->entityOf, order);
+
+    for (uint32_t s = 0; s < n; ++s) {
+        this->slotOf[this->entityOf[s]] = s;
+    }
+    for (uint32_t s = 0; s < n; ++s) {
+        uint32_t p = this->parentEntity[this->entityOf[s]];
+        this->parent[s] = p == NONE ? NONE : this->slotOf[p];
+    }
+    this->unsorted = false;
+}
+
+size_t TransformSystem::update(JobSystem &jobs, size_t grain) {
+    if (this->unsorted) {
+        this->sort();
+    }
+
+    atomic<size_t> recomputed(0);
+    for (size_t l = 0; l + 1 < this->levelFirst.size(); ++l) {
+        // Levels in order, the slots of one in parallel
+        jobs.parallelFor(this->levelFirst[l], this->levelFirst[l + 1], grain, [&](size_t from, size_t to) {
+            // Raw pointers, or every store into world would reload them
+            const uint32_t *parent = this->parent.data();
+            const float *px = this->positionX.data(), *py = this->positionY.data(), *pz = this->positionZ.data();
+            const float *rx = this->rotationX.data(), *ry = this->rotationY.data();
+            const float *rz = this->rotationZ.data(), *rw = this->rotationW.data();
+            const float *scx = this->scaleX.data(), *scy = this->scaleY.data(), *scz = this->scaleZ.data();
+            unsigned char *dirty = this->dirty.data();
+            unsigned char *changed = this->changed.data();
+            float *world = this->world.data();
+
+            size_t count = 0;
+            for (size_t i = from; i < to; ++i) {
+                uint32_t p = parent[i];
+                bool recompute = dirty[i] || (p != NONE && changed[p]);
+                changed[i] = recompute;
+                if (!recompute) {
+                    continue;
+                }
+                dirty[i] = 0;
+                ++count;
+
+                // Local matrix from scale, rotation & translation, as 4 columns of 3
+                float x = rx[i], y = ry[i], z = rz[i], w = rw[i];
+                float sx = scx[i], sy = scy[i], sz = scz[i];
+                float l0[3] = { (1.f - 2.f * (y * y + z * z)) * sx, 2.f * (x * y + w * z) * sx, 2.f * (x * z - w * y) * sx };
+                float l1[3] = { 2.f * (x * y - w * z) * sy, (1.f - 2.f * (x * x + z * z)) * sy, 2.f * (y * z + w * x) * sy };
+                float l2[3] = { 2.f * (x * z + w * y) * sz, 2.f * (y * z - w * x) * sz, (1.f - 2.f * (x * x + y * y)) * sz };
+                float l3[3] = { px[i], py[i], pz[i] };
+
+                float *out = world + i * 16;
+                if (p == NONE) {
+                    out[0] = l0[0]; out[1] = l0[1]; out[2] = l0[2]; out[3] = 0.f;
+                    out[4] = l1[0]; out[5] = l1[1]; out[6] = l1[2]; out[7] = 0.f;
+                    out[8] = l2[0]; out[9] = l2[1]; out[10] = l2[2]; out[11] = 0.f;
+                    out[12] = l3[0]; out[13] = l3[1]; out[14] = l3[2]; out[15] = 1.f;
+                    continue;
+                }
+
+                // Affine parent * local
+                float m[16];
+                memcpy(m, world + p * 16, sizeof(m));
+                for (int r = 0; r < 3; ++r) {
+                    out[0 + r] = m[r] * l0[0] + m[4 + r] * l0[1] + m[8 + r] * l0[2];
+                    out[4 + r] = m[r] * l1[0] + m[4 + r] * l1[1] + m[8 + r] * l1[2];
+                    out[8 + r] = m[r] * l2[0] + m[4 + r] * l2[1] + m[8 + r] * l2[2];
+                    out[12 + r] = m[r] * l3[0] + m[4 + r] * l3[1] + m[8 + r] * l3[2] + m[12 + r];
+                }
+                out[3] = out[7] = out[11] = 0.f;
+                out[15] = 1.f;
+            }
+            recomputed += count;
+        });
+    }
+    return recomputed;
+}
+
+void axisAngleQuaternion(const float axis[3], float angle, float out[4]) {
+    float s = sinf(angle * 0.5f);
+    out[0] = axis[0] * s;
+    out[1] = axis[1] * s;
+    out[2] = axis[2] * s;
+    out[3] = cosf(angle * 0.5f);
+}
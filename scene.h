@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "jobs.h"
+
+// Parent-child transforms of entities in structure-of-arrays layout.
+//
+// Slots are kept sorted by depth, so every parent comes before its
+// children and one linear pass per level computes world matrices. Only
+// entities whose local transform changed, or whose parent's world matrix
+// did, are recomputed. Levels are split across the job system.
+struct TransformSystem {
+    static const uint32_t NONE = ~0u;
+
+    // Per slot, parents first
+    std::vector<uint32_t> parent;  // Slot, NONE for roots
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;  // Unit quaternion
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<unsigned char> dirty;    // Local transform changed since update()
+    std::vector<unsigned char> changed;  // World matrix recomputed by the last update()
+    std::vector<float> world;            // Column-major 4x4 per slot
+    std::vector<uint32_t> levelFirst;    // First slot of each depth, then the end
+
+    // Entity ids stay fixed while slots move
+    std::vector<uint32_t> slotOf;
+    std::vector<uint32_t> entityOf;
+    std::vector<uint32_t> parentEntity;  // Per entity
+    bool unsorted;
+
+    TransformSystem() : unsorted(false) {}
+
+    size_t size() const { return this->entityOf.size(); }
+    void reserve(size_t count);
+
+    // New entity at the origin, unrotated, of scale 1
+    uint32_t create(uint32_t parentEntity = NONE);
+    void setParent(uint32_t entity, uint32_t parentEntity);
+
+    // Safe to call concurrently for different entities
+    void setPosition(uint32_t entity, float x, float y, float z);
+    void setRotation(uint32_t entity, float x, float y, float z, float w);
+    void setScale(uint32_t entity, float x, float y, float z);
+
+    // Valid after update()
+    const float *worldMatrix(uint32_t entity) const { return &this->world[this->slotOf[entity] * 16]; }
+
+    // Recomputes world matrices of changed subtrees; returns how many
+    size_t update(JobSystem &jobs, size_t grain = 4096);
+
+private:
+    // Restores depth order after hierarchy changes
+    void sort();
+};
+
+// Unit quaternion rotating angle radians around the (normalized) axis
+void axisAngleQuaternion(const float axis[3], float angle, float out[4]);
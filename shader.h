@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "context.h"
+#include "glhandle.h"
+
+// Shader sources may share code: a line #include "file.glsl" is replaced
+// by that file, itself expanded the same way. Paths are as given to Shader.
+struct Shader {
+    GLuint shader;
+    GLenum type;
+    std::string source;
+
+    Shader(const GLenum type, const char* path) {
+        // Create shader
+        this->type = type;
+        this->shader = glCreateShader(this->type);
+
+        // Load source
+        if (!load(path, this->source, 0)) {
+            std::cerr << "ERROR::SHADER::" << this->typeName() << "::SOURCE_FILE_CANNOT_BE_OPENED " << path << std::endl;
+
+            SDL_GL_DeleteContext(cont);
+            SDL_DestroyWindow(win);
+            SDL_Quit();
+            exit(1);
+        }
+
+        // Compile
+        const GLchar *text = this->source.c_str();
+        glShaderSource(*this, 1, &text, NULL);
+        glCompileShader(*this);
+
+        int success;
+        glGetShaderiv(*this, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            char infoLog[1024];
+            glGetShaderInfoLog(*this, sizeof(infoLog)/sizeof(infoLog[0]), NULL, infoLog);
+            std::cerr << "ERROR::SHADER::" << this->typeName() << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+
+            SDL_GL_DeleteContext(cont);
+            SDL_DestroyWindow(win);
+            SDL_Quit();
+            exit(1);
+        }
+    }
+
+    operator GLuint() const { return this->shader; }
+
+    const char *typeName() const {
+        switch (this->type) {
+            case GL_VERTEX_SHADER:   return "VERTEX";
+            case GL_FRAGMENT_SHADER: return "FRAGMENT";
+            case GL_COMPUTE_SHADER:  return "COMPUTE";
+        }
+        return "UNKNOWN";
+    }
+
+    ~Shader() {
+        glDeleteShader(*this);
+    }
+
+    // Internal
+    static const int MAX_INCLUDE_DEPTH = 8;
+
+    // Appends path's text to source, expanding includes
+    static bool load(const char *path, std::string &source, int depth) {
+        FILE *file = fopen(path, "r");
+        if (file == NULL) {
+            return false;
+        }
+
+        bool ok = true;
+        std::string line;
+        for (int c = fgetc(file); ok && c != EOF; c = fgetc(file)) {
+            line += (char)c;
+            if (c != '\n') {
+                continue;
+            }
+            ok = include(line, source, depth);
+            line.clear();
+        }
+        ok = ok && include(line, source, depth);
+
+        fclose(file);
+        return ok;
+    }
+
+    static bool include(const std::string &line, std::string &source, int depth) {
+        const std::string directive = "#include \"";
+        size_t end = line.find('"', directive.size());
+        if (line.compare(0, directive.size(), directive) != 0 || end == std::string::npos) {
+            source += line;
+            return true;
+        }
+        std::string path = line.substr(directive.size(), end - directive.size());
+        if (depth >= MAX_INCLUDE_DEPTH || !load(path.c_str(), source, depth + 1)) {
+            std::cerr << "ERROR::SHADER::INCLUDE_FAILED " << path << std::endl;
+            return false;
+        }
+        source += '\n';
+        return true;
+    }
+};
+
+struct ShaderProgram {
+    ProgramHandle program;
+
+    ShaderProgram(const char *vertexShaderPath, const char *fragmentShaderPath) {
+        // Create program
+        this->program = ProgramHandle::create();
+
+        // Create shaders
+        Shader *vertexShader = new Shader(GL_VERTEX_SHADER, vertexShaderPath);
+        Shader *fragmentShader = new Shader(GL_FRAGMENT_SHADER, fragmentShaderPath);
+
+        // Attach Shaders
+        glAttachShader(*this, *vertexShader);
+        glAttachShader(*this, *fragmentShader);
+
+        this->link();
+
+        delete vertexShader;
+        delete fragmentShader;
+    }
+
+    ShaderProgram(const char *computeShaderPath) {
+        // Create program
+        this->program = ProgramHandle::create();
+
+        // Create & attach shader
+        Shader *computeShader = new Shader(GL_COMPUTE_SHADER, computeShaderPath);
+        glAttachShader(*this, *computeShader);
+
+        this->link();
+
+        delete computeShader;
+    }
+
+    void link() {
+        // Link
+        glLinkProgram(*this);
+
+        int success;
+        glGetProgramiv(*this, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[1024];
+            glGetProgramInfoLog(*this, sizeof(infoLog)/sizeof(infoLog[0]), NULL, infoLog);
+            std::cout << "ERROR::SHADER_PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+
+            SDL_GL_DeleteContext(cont);
+            SDL_DestroyWindow(win);
+            SDL_Quit();
+            exit(1);
+        }
+    }
+
+    operator GLuint() const { return this->program; }
+
+    void use() { glUseProgram(*this); }
+
+    void set1i(const char *name, const GLint val) { glUniform1i(glGetUniformLocation(*this, name), val); }
+    void set1ui(const char *name, const GLuint val) { glUniform1ui(glGetUniformLocation(*this, name), val); }
+    void set2i(const char *name, const GLint x, const GLint y) { glUniform2i(glGetUniformLocation(*this, name), x, y); }
+    void set2f(const char *name, const GLfloat x, const GLfloat y) { glUniform2f(glGetUniformLocation(*this, name), x, y); }
+    void set3f(const char *name, const GLfloat x, const GLfloat y, const GLfloat z) { glUniform3f(glGetUniformLocation(*this, name), x, y, z); }
+    void set4fv(const char *name, const int count, const GLfloat *val) { glUniform4fv(glGetUniformLocation(*this, name), count, val); }
+    void setMatrix4fv(const char *name, const int count, const GLfloat *val) { glUniformMatrix4fv(glGetUniformLocation(*this, name), count, GL_FALSE, val); }
+};
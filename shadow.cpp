@@ -0,0 +1,198 @@
+#include "shadow.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace std;
+using namespace glm;
+
+const int CascadedShadows::CASCADES;
+const int CascadedShadows::TILE_SIZE;
+const int CascadedShadows::ATLAS_SIZE;
+
+// Share of logarithmic vs uniform cascade splits
+static const float SPLIT_LAMBDA = 0.5f;
+
+// How far towards the light casters outside a cascade's sphere are still caught
+static const float CASTER_DISTANCE = 64.f;
+
+// Depth range steps per cascade radius. Its center is snapped to them and
+// the range padded by half a step, so moves along the light keep the fit.
+static const float DEPTH_STEPS = 4.f;
+
+// Depth slope bias while drawing casters; normal offset is done when sampling
+static const float SLOPE_BIAS = 2.f;
+static const float CONSTANT_BIAS = 4.f;
+
+static void allocate(GLuint texture, GLuint framebuffer) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, CascadedShadows::ATLAS_SIZE, CascadedShadows::ATLAS_SIZE,
+            0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "ERROR::SHADOWS::ATLAS_INCOMPLETE" << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+CascadedShadows::CascadedShadows(const float direction[3], bool caching)
+        : atlas(TextureHandle::create()), framebuffer(FramebufferHandle::create()),
+          staticAtlas(TextureHandle::create()), staticFramebuffer(FramebufferHandle::create()),
+          caching(caching) {
+    vec3 d = normalize(make_vec3(direction));
+    memcpy(this->direction, value_ptr(d), sizeof(this->direction));
+
+    allocate(this->atlas, this->framebuffer);
+    if (caching) {
+        allocate(this->staticAtlas, this->staticFramebuffer);
+    }
+    this->program = new ShaderProgram("shadow_vertex.glsl", "shadow_fragment.glsl");
+    this->invalidate();
+}
+
+CascadedShadows::~CascadedShadows() {
+    delete this->program;
+}
+
+void CascadedShadows::fit(const float *view, float fovy, float aspect, float near, float far) {
+    mat4 viewMatrix = make_mat4(view);
+    mat4 inverseView = inverse(viewMatrix);
+    for (int k = 0; k < 4; ++k) {
+        this->depthPlane[k] = -view[k * 4 + 2];
+    }
+
+    // Light space rotation only depends on the direction, so snapping in it is stable
+    vec3 towardsLight = make_vec3(this->direction);
+    vec3 up = fabsf(towardsLight.y) > 0.99f ? vec3(1.f, 0.f, 0.f) : vec3(0.f, 1.f, 0.f);
+    mat4 lightView = lookAt(vec3(0.f), -towardsLight, up);
+
+    // Squared radius of the frustum's cross section per unit of depth
+    float tanY = tanf(fovy / 2.f);
+    float tanX = tanY * aspect;
+    float k2 = tanX * tanX + tanY * tanY;
+
+    float begin = near;
+    for (int c = 0; c < CASCADES; ++c) {
+        float t = float(c + 1) / CASCADES;
+        float end = mix(near + (far - near) * t, near * powf(far / near, t), SPLIT_LAMBDA);
+        this->ends[c] = end;
+
+        // Smallest sphere around the slice [begin, end] of the frustum, centered on its axis
+        float center = min((begin + end) * 0.5f * (1.f + k2), end);
+        float radius = sqrtf((end - center) * (end - center) + end * end * k2);
+        radius = ceilf(radius * 16.f) / 16.f;  // Keeps float noise from resizing it
+        begin = end;
+
+        // Center snapped to whole texels in light space, and its depth to coarser steps
+        float texel = 2.f * radius / TILE_SIZE;
+        float depthStep = radius / DEPTH_STEPS;
+        vec4 world = inverseView * vec4(0.f, 0.f, -center, 1.f);
+        vec4 light = lightView * world;
+        light.x = floorf(light.x / texel + 0.5f) * texel;
+        light.y = floorf(light.y / texel + 0.5f) * texel;
+        light.z = floorf(light.z / depthStep + 0.5f) * depthStep;
+
+        float depthPadding = 0.5f * depthStep;
+        mat4 projection = ortho(light.x - radius, light.x + radius, light.y - radius, light.y + radius,
+                                -light.z - radius - depthPadding - CASTER_DISTANCE, -light.z + radius + depthPadding);
+        mat4 lightViewProjection = projection * lightView;
+        memcpy(this->viewProjection[c], value_ptr(lightViewProjection), sizeof(this->viewProjection[c]));
+        this->texelSize[c] = texel;
+    }
+}
+
+bool CascadedShadows::staticStale(int cascade) const {
+    return !this->cached[cascade]
+        || memcmp(this->cachedViewProjection[cascade], this->viewProjection[cascade], sizeof(float) * 16) != 0;
+}
+
+void CascadedShadows::beginStatic(int cascade) {
+    glBindFramebuffer(GL_FRAMEBUFFER, this->staticFramebuffer);
+    this->beginCascade(cascade);
+
+    int x = cascade % 2 * TILE_SIZE;
+    int y = cascade / 2 * TILE_SIZE;
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y, TILE_SIZE, TILE_SIZE);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+
+    memcpy(this->cachedViewProjection[cascade], this->viewProjection[cascade], sizeof(float) * 16);
+    this->cached[cascade] = true;
+}
+
+void CascadedShadows::beginDynamic() {
+    if (this->caching) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, this->staticFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->framebuffer);
+        glBlitFramebuffer(0, 0, ATLAS_SIZE, ATLAS_SIZE, 0, 0, ATLAS_SIZE, ATLAS_SIZE,
+                GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    if (!this->caching) {
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+}
+
+void CascadedShadows::beginCascade(int cascade) {
+    glViewport(cascade % 2 * TILE_SIZE, cascade / 2 * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(SLOPE_BIAS, CONSTANT_BIAS);
+    this->program->use();
+}
+
+void CascadedShadows::end() {
+    glDisable(GL_POLYGON_OFFSET_FILL);
+}
+
+unsigned CascadedShadows::selectLod(int cascade, const vector<MeshLod> &lods) const {
+    unsigned lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error <= this->texelSize[cascade]) {
+        ++lod;
+    }
+    return lod;
+}
+
+void CascadedShadows::bind(ShaderProgram &program, int unit) {
+    // Light clip space to the cascade's tile of the atlas
+    float matrices[CASCADES][16];
+    for (int c = 0; c < CASCADES; ++c) {
+        mat4 tile(1.f);
+        tile = translate(tile, vec3(0.25f + c % 2 * 0.5f, 0.25f + c / 2 * 0.5f, 0.5f));
+        tile = scale(tile, vec3(0.25f, 0.25f, 0.5f));
+        mat4 m = tile * make_mat4(this->viewProjection[c]);
+        memcpy(matrices[c], value_ptr(m), sizeof(matrices[c]));
+    }
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, this->atlas);
+    glActiveTexture(GL_TEXTURE0);
+
+    program.set1i("shadowAtlas", unit);
+    program.setMatrix4fv("shadowMatrices", CASCADES, &matrices[0][0]);
+    program.set4fv("cascadeEnds", 1, this->ends);
+    program.set4fv("cascadeTexels", 1, this->texelSize);
+    program.set4fv("depthPlane", 1, this->depthPlane);
+}
+
+void CascadedShadows::invalidate() {
+    for (int c = 0; c < CASCADES; ++c) {
+        this->cached[c] = false;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "context.h"
+#include "glhandle.h"
+#include "mesh.h"
+#include "shader.h"
+
+// Cascaded shadow maps for the sun, in a depth atlas of 2x2 tiles.
+//
+// Cascades are fitted to bounding spheres of slices of the view frustum
+// and snapped to whole shadow texels, so they don't shimmer as the camera
+// moves and stay put while it doesn't. That lets static casters be drawn
+// once into a cached atlas: each frame it is copied into the sampled atlas
+// and only dynamic casters are drawn on top. A cascade's static tile is
+// redrawn only when its fit changes or invalidate() is called.
+struct CascadedShadows {
+    static const int CASCADES = 4;
+    static const int TILE_SIZE = 1024;
+    static const int ATLAS_SIZE = 2 * TILE_SIZE;
+
+    TextureHandle atlas;        // Sampled: static & dynamic casters
+    FramebufferHandle framebuffer;
+    TextureHandle staticAtlas;  // Cached static casters
+    FramebufferHandle staticFramebuffer;
+    ShaderProgram *program;     // Depth only caster shader
+
+    float direction[3];  // Towards the light
+    bool caching;        // Off: everything is drawn every frame
+
+    // Fitted by fit()
+    float ends[CASCADES];               // View depth each cascade reaches
+    float viewProjection[CASCADES][16];
+    float texelSize[CASCADES];          // World size of a shadow texel
+    float depthPlane[4];                // View depth of a point p is dot(depthPlane, (p, 1))
+
+    // Fit the static tiles were drawn with
+    float cachedViewProjection[CASCADES][16];
+    bool cached[CASCADES];
+
+    CascadedShadows(const float direction[3], bool caching = true);
+    ~CascadedShadows();
+
+    // Fits cascades to a camera at view with perspective(fovy, aspect, near, far)
+    void fit(const float *view, float fovy, float aspect, float near, float far);
+
+    // Whether cascade's static casters must be drawn this frame
+    bool staticStale(int cascade) const;
+
+    // Binds cascade's static tile, cleared, for drawing its static casters
+    void beginStatic(int cascade);
+
+    // Copies the static atlas into the sampled one (or clears it when not
+    // caching) and binds it for drawing dynamic casters
+    void beginDynamic();
+
+    // Viewport to cascade's tile of the bound atlas
+    void beginCascade(int cascade);
+
+    // Restores state after drawing casters
+    void end();
+
+    // Coarsest lod whose error stays within one of cascade's texels
+    unsigned selectLod(int cascade, const std::vector<MeshLod> &lods) const;
+
+    // Atlas to the given texture unit, with the uniforms sunShadow() needs
+    void bind(ShaderProgram &program, int unit);
+
+    // Static casters changed; redraw them all next frame
+    void invalidate();
+};
@@ -0,0 +1,13 @@
+#version 330 core
+
+// Shadow casters: depth only
+
+layout (location = 0) in vec3 pos;    // unorm16, relative to bounds
+layout (location = 2) in mat4 mvp;    // Light view-projection * model
+
+uniform vec3 boundsMin;
+uniform vec3 boundsExtent;
+
+void main() {
+    gl_Position = mvp * vec4(boundsMin + pos * boundsExtent, 1.0);
+}
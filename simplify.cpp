@@ -0,0 +1,410 @@
+#include "simplify.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "meshopt.h"
+
+using namespace std;
+
+namespace {
+
+// Sum of squared distances to a set of planes, weighted by triangle area:
+// error(p) = p.A.p + 2 b.p + c
+struct Quadric {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+void quadricAdd(Quadric &q, const Quadric &other) {
+    q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+    q.a11 += other.a11; q.a12 += other.a12; q.a22 += other.a22;
+    q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// Plane n.p + d = 0 with unit n
+Quadric planeQuadric(const double n[3], double d, double weight) {
+    Quadric q;
+    q.a00 = weight * n[0] * n[0]; q.a01 = weight * n[0] * n[1]; q.a02 = weight * n[0] * n[2];
+    q.a11 = weight * n[1] * n[1]; q.a12 = weight * n[1] * n[2]; q.a22 = weight * n[2] * n[2];
+    q.b0 = weight * n[0] * d; q.b1 = weight * n[1] * d; q.b2 = weight * n[2] * d;
+    q.c = weight * d * d;
+    q.weight = weight;
+    return q;
+}
+
+// Mean squared distance of p to the planes
+double quadricError(const Quadric &q, const float *p) {
+    double x = p[0], y = p[1], z = p[2];
+    double e = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+             + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+             + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+    return q.weight > 0.0 ? fabs(e) / q.weight : 0.0;
+}
+
+void triangleNormal(const float *p0, const float *p1, const float *p2, double n[3]) {
+    double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+struct PositionKey {
+    uint32_t bits[3];
+
+    bool operator==(const PositionKey &other) const {
+        return memcmp(this->bits, other.bits, sizeof(this->bits)) == 0;
+    }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey &key) const {
+        uint64_t h = key.bits[0];
+        h = h * 0x9e3779b97f4a7c15ull ^ key.bits[1];
+        h = h * 0x9e3779b97f4a7c15ull ^ key.bits[2];
+        return h ^ (h >> 29);
+    }
+};
+
+struct Collapse {
+    unsigned from;
+    unsigned to;
+    float cost;       // Including attributes, for ordering
+    float distance;   // Squared geometric error
+};
+
+// Edge collapse state, so that a LOD chain is one continuous run with
+// errors measured against the full mesh
+struct Simplifier {
+    const float *vertices;
+    size_t stride;
+    size_t vertexCount;
+    float attributeWeight;
+
+    vector<unsigned> indices;
+    vector<char> locked;
+    vector<Quadric> quadrics;
+    float error;
+
+    // Per pass
+    vector<unsigned> offsets;
+    vector<unsigned> adjacency;
+    vector<Collapse> collapses;
+    vector<unsigned> remap;
+    vector<char> touched;
+
+    Simplifier(const unsigned *indices, size_t indexCount,
+            const float *vertices, size_t stride, size_t vertexCount, float attributeWeight);
+
+    float attributeCost(unsigned a, unsigned b) const;
+    bool flips(unsigned from, unsigned to) const;
+    void buildAdjacency();
+    void findCollapses(double errorLimit, JobSystem *jobs);
+
+    // Continues collapsing down to targetIndexCount
+    void run(size_t targetIndexCount, float targetError, JobSystem *jobs);
+};
+
+Simplifier::Simplifier(const unsigned *indices, size_t indexCount,
+        const float *vertices, size_t stride, size_t vertexCount, float attributeWeight)
+        : vertices(vertices), stride(stride), vertexCount(vertexCount), attributeWeight(attributeWeight),
+          indices(indices, indices + indexCount - indexCount % 3), error(0.f) {
+    const vector<unsigned> &tris = this->indices;
+
+    // Vertices sharing a position: one representative each
+    vector<unsigned> position(vertexCount);
+    vector<unsigned> shared(vertexCount, 0);
+    {
+        unordered_map<PositionKey, unsigned, PositionKeyHash> unique;
+        unique.reserve(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            PositionKey key;
+            memcpy(key.bits, &vertices[v * stride], sizeof(key.bits));
+            position[v] = unique.emplace(key, v).first->second;
+            ++shared[position[v]];
+        }
+    }
+
+    // Seams & borders (edges of a single triangle, or of more than two) are locked
+    this->locked.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        this->locked[v] = shared[position[v]] > 1;
+    }
+    {
+        unordered_map<uint64_t, unsigned> edges;
+        edges.reserve(tris.size());
+        for (size_t i = 0; i < tris.size(); ++i) {
+            unsigned a = position[tris[i]];
+            unsigned b = position[tris[i - i % 3 + (i + 1) % 3]];
+            uint64_t key = ((uint64_t)min(a, b) << 32) | max(a, b);
+            ++edges[key];
+        }
+        vector<char> border(vertexCount, 0);
+        for (const auto &edge : edges) {
+            if (edge.second != 2) {
+                border[edge.first >> 32] = 1;
+                border[edge.first & 0xffffffff] = 1;
+            }
+        }
+        for (size_t v = 0; v < vertexCount; ++v) {
+            this->locked[v] |= border[position[v]];
+        }
+    }
+
+    // Plane quadrics of adjacent triangles
+    Quadric zero;
+    memset(&zero, 0, sizeof(zero));
+    this->quadrics.assign(vertexCount, zero);
+    for (size_t t = 0; t < tris.size(); t += 3) {
+        const float *p0 = &vertices[tris[t + 0] * stride];
+        const float *p1 = &vertices[tris[t + 1] * stride];
+        const float *p2 = &vertices[tris[t + 2] * stride];
+        double n[3];
+        triangleNormal(p0, p1, p2, n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0) {
+            continue;
+        }
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        Quadric q = planeQuadric(n, d, length * 0.5);
+        for (int k = 0; k < 3; ++k) {
+            quadricAdd(this->quadrics[tris[t + k]], q);
+        }
+    }
+
+    this->offsets.resize(vertexCount + 1);
+    this->remap.resize(vertexCount);
+    this->touched.resize(vertexCount);
+}
+
+float Simplifier::attributeCost(unsigned a, unsigned b) const {
+    float sum = 0.f;
+    for (size_t k = 3; k < this->stride; ++k) {
+        float d = this->vertices[a * this->stride + k] - this->vertices[b * this->stride + k];
+        sum += d * d;
+    }
+    return sum * this->attributeWeight;
+}
+
+// Whether collapsing from onto to turns any remaining triangle around
+bool Simplifier::flips(unsigned from, unsigned to) const {
+    for (unsigned a = this->offsets[from]; a < this->offsets[from + 1]; ++a) {
+        const unsigned *tri = &this->indices[this->adjacency[a] * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to) {
+            continue;
+        }
+        const float *p[3], *q[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = &this->vertices[tri[k] * this->stride];
+            q[k] = tri[k] == from ? &this->vertices[to * this->stride] : p[k];
+        }
+        double before[3], after[3];
+        triangleNormal(p[0], p[1], p[2], before);
+        triangleNormal(q[0], q[1], q[2], after);
+        if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Simplifier::buildAdjacency() {
+    const vector<unsigned> &tris = this->indices;
+    fill(this->offsets.begin(), this->offsets.end(), 0);
+    for (unsigned v : tris) {
+        ++this->offsets[v + 1];
+    }
+    for (size_t v = 0; v < this->vertexCount; ++v) {
+        this->offsets[v + 1] += this->offsets[v];
+    }
+    this->adjacency.resize(tris.size());
+    vector<unsigned> fillAt(this->offsets.begin(), this->offsets.end() - 1);
+    for (size_t i = 0; i < tris.size(); ++i) {
+        this->adjacency[fillAt[tris[i]]++] = i / 3;
+    }
+}
+
+// Cheaper direction of every edge within errorLimit, cheapest first
+void Simplifier::findCollapses(double errorLimit, JobSystem *jobs) {
+    const size_t GRAIN = 16384;
+    const vector<unsigned> &tris = this->indices;
+    this->collapses.resize(tris.size());
+
+    auto evaluate = [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; ++i) {
+            unsigned a = tris[i];
+            unsigned b = tris[i - i % 3 + (i + 1) % 3];
+            Collapse best = { 0, 0, FLT_MAX, FLT_MAX };
+            // Each interior edge shows up in two triangles; evaluate it once
+            if (a < b || this->locked[a] || this->locked[b]) {
+                for (int direction = 0; direction < 2; ++direction) {
+                    unsigned source = direction ? b : a;
+                    unsigned target = direction ? a : b;
+                    if (this->locked[source]) {
+                        continue;
+                    }
+                    float distance = quadricError(this->quadrics[source], &this->vertices[target * this->stride]);
+                    float cost = distance + this->attributeCost(source, target);
+                    if (cost < best.cost && distance <= errorLimit) {
+                        best.from = source;
+                        best.to = target;
+                        best.cost = cost;
+                        best.distance = distance;
+                    }
+                }
+            }
+            this->collapses[i] = best;
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(0, tris.size(), GRAIN, evaluate);
+    } else {
+        evaluate(0, tris.size());
+    }
+
+    this->collapses.erase(remove_if(this->collapses.begin(), this->collapses.end(),
+            [](const Collapse &c) { return c.cost == FLT_MAX; }), this->collapses.end());
+    sort(this->collapses.begin(), this->collapses.end(),
+            [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+}
+
+void Simplifier::run(size_t targetIndexCount, float targetError, JobSystem *jobs) {
+    double errorLimit = (double)targetError * targetError;
+    vector<unsigned> &tris = this->indices;
+
+    while (tris.size() > targetIndexCount) {
+        this->buildAdjacency();
+        this->findCollapses(errorLimit, jobs);
+
+        // Independent collapses, cheapest first: each touches its own neighbourhood only
+        for (size_t v = 0; v < this->vertexCount; ++v) {
+            this->remap[v] = v;
+        }
+        fill(this->touched.begin(), this->touched.end(), 0);
+        size_t trianglesToRemove = (tris.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+        for (const Collapse &c : this->collapses) {
+            if (removed >= trianglesToRemove) {
+                break;
+            }
+            if (this->touched[c.from] || this->touched[c.to] || this->flips(c.from, c.to)) {
+                continue;
+            }
+
+            for (unsigned a = this->offsets[c.from]; a < this->offsets[c.from + 1]; ++a) {
+                const unsigned *tri = &tris[this->adjacency[a] * 3];
+                this->touched[tri[0]] = this->touched[tri[1]] = this->touched[tri[2]] = 1;
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+                    ++removed;
+                }
+            }
+            this->remap[c.from] = c.to;
+            quadricAdd(this->quadrics[c.to], this->quadrics[c.from]);
+            this->error = max(this->error, sqrtf(c.distance));
+            ++applied;
+        }
+        if (applied == 0) {
+            break;
+        }
+
+        // Rewrite, dropping triangles that became degenerate
+        size_t out = 0;
+        for (size_t t = 0; t < tris.size(); t += 3) {
+            unsigned a = this->remap[tris[t]], b = this->remap[tris[t + 1]], c = this->remap[tris[t + 2]];
+            if (a != b && b != c && a != c) {
+                tris[out++] = a;
+                tris[out++] = b;
+                tris[out++] = c;
+            }
+        }
+        tris.resize(out);
+    }
+}
+
+}
+
+size_t simplifyMesh(unsigned *dst, const unsigned *indices, size_t indexCount,
+        const float *vertices, size_t stride, size_t vertexCount,
+        size_t targetIndexCount, float targetError, float attributeWeight, float *error) {
+    Simplifier simplifier(indices, indexCount, vertices, stride, vertexCount, attributeWeight);
+    simplifier.run(targetIndexCount, targetError, NULL);
+
+    copy(simplifier.indices.begin(), simplifier.indices.end(), dst);
+    if (error) {
+        *error = simplifier.error;
+    }
+    return simplifier.indices.size();
+}
+
+vector<MeshLod> generateLods(Mesh &mesh, JobSystem &jobs, unsigned maxLods) {
+    // Coarser levels must remove at least this share of the previous one
+    const float MIN_REDUCTION = 0.1f;
+    // Triangle budget alone decides, the error is only measured
+    const float NO_ERROR_LIMIT = FLT_MAX;
+    const float ATTRIBUTE_WEIGHT = 0.1f;
+
+    size_t indexCount = mesh.indices.size() - mesh.indices.size() % 3;
+    size_t vertexCount = mesh.vertexCount();
+
+    vector<MeshLod> lods;
+    vector<vector<unsigned>> levels;
+    levels.emplace_back(mesh.indices.begin(), mesh.indices.begin() + indexCount);
+    MeshLod full = { 0, (uint32_t)indexCount, 0.f, 0 };
+    lods.push_back(full);
+
+    // Coarser levels continue from finer ones
+    Simplifier simplifier(mesh.indices.data(), indexCount,
+            mesh.vertices.data(), mesh.stride, vertexCount, ATTRIBUTE_WEIGHT);
+    for (unsigned l = 1; l < maxLods; ++l) {
+        simplifier.run((indexCount >> l) / 3 * 3, NO_ERROR_LIMIT, &jobs);
+        if (simplifier.indices.empty() || simplifier.indices.size() > (1.f - MIN_REDUCTION) * lods.back().indexCount) {
+            break;
+        }
+        MeshLod lod = { 0, (uint32_t)simplifier.indices.size(), simplifier.error, 0 };
+        lods.push_back(lod);
+        levels.push_back(simplifier.indices);
+    }
+
+    // Simplification scatters triangles; restore cache locality
+    jobs.parallelFor(1, levels.size(), 1, [&](size_t from, size_t to) {
+        for (size_t l = from; l < to; ++l) {
+            vector<unsigned> optimized(levels[l].size());
+            optimizeVertexCache(optimized.data(), levels[l].data(), levels[l].size(), vertexCount);
+            levels[l].swap(optimized);
+        }
+    });
+
+    mesh.indices.clear();
+    for (size_t l = 0; l < levels.size(); ++l) {
+        lods[l].firstIndex = mesh.indices.size();
+        mesh.indices.insert(mesh.indices.end(), levels[l].begin(), levels[l].end());
+    }
+    return lods;
+}
+
+float lodScale(float fovy, float viewportHeight) {
+    return viewportHeight / (2.f * tanf(fovy * 0.5f));
+}
+
+unsigned selectLod(const vector<MeshLod> &lods, float distance, float scale, float threshold) {
+    distance = max(distance, 1e-6f);
+    for (unsigned l = lods.size(); l-- > 1;) {
+        if (lods[l].error * scale / distance <= threshold) {
+            return l;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "jobs.h"
+#include "mesh.h"
+
+// Quadric error metric edge collapse. Vertices are only collapsed onto
+// their neighbours, so the result still indexes the original vertex buffer.
+// Vertices on open borders and attribute seams (same position, different
+// attributes) are locked. Attributes after the position add
+// attributeWeight times their squared difference to a collapse's cost.
+//
+// Stops at targetIndexCount, or before a collapse would move the surface
+// by more than targetError. Returns the new index count; if error is given
+// it receives the largest deviation introduced.
+size_t simplifyMesh(unsigned *dst, const unsigned *indices, size_t indexCount,
+        const float *vertices, size_t stride, size_t vertexCount,
+        size_t targetIndexCount, float targetError, float attributeWeight = 0.1f, float *error = NULL);
+
+// LOD chain of the mesh: the full mesh, then levels of about half the
+// triangles of the one before, each simplified from the full mesh on the
+// job system. The chain ends once a level no longer gets noticeably
+// smaller. All levels' indices end up back to back in mesh.indices.
+std::vector<MeshLod> generateLods(Mesh &mesh, JobSystem &jobs, unsigned maxLods = 8);
+
+// Screen pixels per object space unit at distance 1, for perspective(fovy, ...)
+// on a viewport this many pixels high
+float lodScale(float fovy, float viewportHeight);
+
+// Coarsest lod whose error projects to at most threshold pixels at distance
+unsigned selectLod(const std::vector<MeshLod> &lods, float distance, float scale, float threshold = 1.f);
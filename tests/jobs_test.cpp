@@ -0,0 +1,49 @@
+// Job system under load: many short parallelFor calls, each on a counter
+// of its own that dies as soon as it returns, plus dependency chains
+
+#include <atomic>
+#include <cstdio>
+
+#include "jobs.h"
+
+using namespace std;
+
+static const int ROUNDS = 20000;
+
+static int failures = 0;
+
+static void expect(long value, long expected, const char *what) {
+    if (value != expected) {
+        printf("FAIL %s: %ld, expected %ld\n", what, value, expected);
+        ++failures;
+    }
+}
+
+int main() {
+    JobSystem jobs(4);
+
+    // Short loops, so the last job often finishes as the caller checks the counter
+    atomic<long> sum(0);
+    for (int r = 0; r < ROUNDS; ++r) {
+        jobs.parallelFor(0, 8, 1, [&](size_t from, size_t to) {
+            sum.fetch_add(to - from, memory_order_relaxed);
+        });
+    }
+    expect(sum.load(), 8L * ROUNDS, "items run by blocking loops");
+
+    // Jobs of a second counter start only after the first is done
+    atomic<long> first(0);
+    atomic<long> early(0);
+    for (int r = 0; r < ROUNDS / 10; ++r) {
+        JobCounter a, b;
+        first = 0;
+        jobs.parallelFor(0, 16, 1, [&](size_t, size_t) { first.fetch_add(1); }, &a);
+        jobs.parallelFor(0, 16, 1, [&](size_t, size_t) { early += first.load() != 16; }, &b, &a);
+        jobs.wait(&b);
+        jobs.wait(&a);
+    }
+    expect(early.load(), 0, "dependent jobs started early");
+
+    printf("jobs: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
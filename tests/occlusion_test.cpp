@@ -0,0 +1,98 @@
+// Software occlusion on a headless box: a wall of known size is
+// rasterized, then boxes in front of, behind, beside and across the near
+// plane are tested against it
+
+#include <cstdio>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "jobs.h"
+#include "occlusion.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void expect(bool visible, bool expected, const char *what) {
+    if (visible != expected) {
+        printf("FAIL %s: %s, expected %s\n", what, visible ? "visible" : "occluded",
+                expected ? "visible" : "occluded");
+        ++failures;
+    }
+}
+
+int main() {
+    JobSystem jobs(2);
+    OcclusionBuffer buffer(256, 128);
+
+    // Camera at the origin looking down +z
+    const float NEAR = 0.5f;
+    glm::mat4 viewProjection = glm::perspective(1.f, 2.f, NEAR, 100.f)
+            * glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 1.f, 0.f));
+    const float *vp = glm::value_ptr(viewProjection);
+
+    // Wall 8 wide & 4 high at z = 10
+    const float wall[] = {
+        -4.f, -2.f, 10.f,   4.f, -2.f, 10.f,   4.f, 2.f, 10.f,   -4.f, 2.f, 10.f,
+    };
+    const unsigned quad[] = { 0, 1, 2, 0, 2, 3 };
+
+    // Nothing rasterized yet
+    buffer.clear();
+    buffer.rasterize(jobs);
+    const float extent[3] = { 0.5f, 0.5f, 0.5f };
+    const float behind[3] = { 0.f, 0.f, 20.f };
+    expect(buffer.testBox(vp, behind, extent), true, "behind, empty buffer");
+
+    buffer.clear();
+    buffer.addOccluder(vp, wall, 3, quad, 6);
+    buffer.rasterize(jobs);
+
+    size_t covered = 0;
+    for (float d : buffer.depth) {
+        covered += d < 1.f;
+    }
+    if (covered == 0 || covered == buffer.depth.size()) {
+        printf("FAIL wall covers %zu of %zu pixels\n", covered, buffer.depth.size());
+        ++failures;
+    }
+
+    expect(buffer.testBox(vp, behind, extent), false, "behind the wall");
+
+    const float front[3] = { 0.f, 0.f, 5.f };
+    expect(buffer.testBox(vp, front, extent), true, "in front of the wall");
+
+    const float beside[3] = { 12.f, 0.f, 20.f };
+    expect(buffer.testBox(vp, beside, extent), true, "behind, beside the wall");
+
+    const float edge[3] = { 8.f, 0.f, 20.f };
+    expect(buffer.testBox(vp, edge, extent), true, "behind, across the wall's edge");
+
+    const float piercing[3] = { 0.f, 0.f, 10.f };
+    const float deep[3] = { 0.5f, 0.5f, 2.f };
+    expect(buffer.testBox(vp, piercing, deep), true, "through the wall");
+
+    // Boxes reaching behind the camera can't be projected and must stay visible
+    const float straddling[3] = { 0.f, 0.f, NEAR };
+    expect(buffer.testBox(vp, straddling, extent), true, "across the near plane");
+
+    const float camera[3] = { 0.f, 0.f, 0.f };
+    const float large[3] = { 30.f, 30.f, 30.f };
+    expect(buffer.testBox(vp, camera, large), true, "around the camera");
+
+    // Occluder triangles reaching behind the camera are dropped, never projected wrongly
+    const float floor[] = {
+        -4.f, -1.f, -5.f,   4.f, -1.f, -5.f,   4.f, -1.f, 50.f,   -4.f, -1.f, 50.f,
+    };
+    buffer.clear();
+    buffer.addOccluder(vp, floor, 3, quad, 6);
+    buffer.rasterize(jobs);
+    const float under[3] = { 0.f, -3.f, 20.f };
+    expect(buffer.testBox(vp, under, extent), true, "under a floor reaching behind the camera");
+    expect(buffer.testBox(vp, behind, extent), true, "above a floor reaching behind the camera");
+
+    printf("occlusion: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
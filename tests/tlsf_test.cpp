@@ -0,0 +1,86 @@
+// TLSF allocator bookkeeping: exact fits off class boundaries, splitting,
+// merging on free, growing and defragmenting
+
+#include <cstdio>
+#include <vector>
+
+#include "tlsf.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        ++failures;
+    }
+}
+
+// Blocks tile [0, capacity) and the free lists agree with the block flags
+static bool consistent(const TlsfAllocator &a) {
+    uint64_t end = a.capacity;
+    uint64_t used = 0;
+    for (uint32_t b = a.lastBlock; b != TlsfAllocator::INVALID; b = a.blocks[b].prevPhysical) {
+        const TlsfAllocator::Block &block = a.blocks[b];
+        if (block.offset + block.size != end || block.size == 0) {
+            return false;
+        }
+        end = block.offset;
+        used += block.free ? 0 : block.size;
+    }
+    return end == 0 && used == a.used;
+}
+
+int main() {
+    // A request of exactly the free space, off a class boundary
+    const uint64_t sizes[] = { 1, 15, 16, 17, 101, 24000, 65535, 1000001 };
+    for (uint64_t size : sizes) {
+        TlsfAllocator a(size);
+        uint32_t block = a.allocate(size);
+        expect(block != TlsfAllocator::INVALID && a.offset(block) == 0 && a.size(block) == size,
+                "exact fit of the whole range");
+        expect(a.allocate(1) == TlsfAllocator::INVALID, "nothing left after an exact fit");
+        expect(consistent(a), "consistent after an exact fit");
+    }
+
+    // Growing by the rounded size always makes room
+    for (uint64_t size : sizes) {
+        TlsfAllocator a(10);
+        a.allocate(10);
+        a.grow(10 + TlsfAllocator::roundUp(size));
+        expect(a.allocate(size) != TlsfAllocator::INVALID, "fit after growing by the rounded size");
+    }
+
+    // Splits, frees in mixed order, merges back to one block
+    TlsfAllocator a(1000);
+    vector<uint32_t> blocks;
+    for (int i = 0; i < 10; ++i) {
+        blocks.push_back(a.allocate(100));
+    }
+    expect(a.allocate(1) == TlsfAllocator::INVALID, "full after ten blocks");
+    for (int i = 0; i < 10; i += 2) {
+        a.free(blocks[i]);
+    }
+    expect(consistent(a) && a.stats().freeBlocks == 5 && a.stats().largestFree == 100, "five holes");
+    expect(a.allocate(101) == TlsfAllocator::INVALID, "no hole fits more than it holds");
+    uint32_t hole = a.allocate(100);
+    expect(hole != TlsfAllocator::INVALID, "a hole fits exactly");
+    a.free(hole);
+
+    // Defragmenting packs the survivors in order
+    vector<TlsfAllocator::Move> moves = a.defragment();
+    expect(moves.size() == 5 && consistent(a), "odd blocks moved to the front");
+    for (int i = 1; i < 10; i += 2) {
+        expect(a.offset(blocks[i]) == uint64_t(i / 2 * 100), "packed in offset order");
+    }
+    expect(a.stats().freeBlocks == 1 && a.stats().largestFree == 500, "one free block after defragmenting");
+
+    for (int i = 1; i < 10; i += 2) {
+        a.free(blocks[i]);
+    }
+    expect(consistent(a) && a.used == 0 && a.stats().largestFree == 1000, "all merged after freeing");
+
+    printf("tlsf: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+// Every batch matrix kernel against glm's operator*. The kernels take one
+// matrix per iteration, so the lengths cover an empty batch, odd and even
+// ones around powers of two and a long one; a guard matrix after each
+// batch catches writes past its end.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "transform.h"
+
+using namespace std;
+
+typedef void (*Kernel)(const float *a, const float *b, float *out, size_t count);
+
+static const float EPSILON = 1e-4f;  // Relative to the largest element
+
+static bool supported(TransformIsa isa) {
+    __builtin_cpu_init();
+    switch (isa) {
+        case TRANSFORM_SCALAR: return true;
+        case TRANSFORM_SSE:    return __builtin_cpu_supports("sse2");
+        case TRANSFORM_AVX2:   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case TRANSFORM_AVX512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+}
+
+int main() {
+    const Kernel kernels[] = { mulMat4BatchScalar, mulMat4BatchSse, mulMat4BatchAvx2, mulMat4BatchAvx512 };
+    const size_t counts[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 1000 };
+
+    mt19937 rng(1);
+    uniform_real_distribution<float> value(-10.f, 10.f);
+
+    int failures = 0;
+    for (size_t count : counts) {
+        glm::mat4 a;
+        for (int i = 0; i < 16; ++i) {
+            glm::value_ptr(a)[i] = value(rng);
+        }
+        vector<glm::mat4> b(count);
+        vector<glm::mat4> expected(count);
+        for (size_t m = 0; m < count; ++m) {
+            for (int i = 0; i < 16; ++i) {
+                glm::value_ptr(b[m])[i] = value(rng);
+            }
+            expected[m] = a * b[m];
+        }
+
+        for (int k = TRANSFORM_SCALAR; k <= TRANSFORM_AVX512; ++k) {
+            TransformIsa isa = TransformIsa(k);
+            if (!supported(isa)) {
+                continue;
+            }
+            // Guard matrix after the batch catches writes past its end
+            vector<glm::mat4> out(count + 1, glm::mat4(12345.f));
+            kernels[k](glm::value_ptr(a), count ? glm::value_ptr(b[0]) : NULL, glm::value_ptr(out[0]), count);
+
+            for (size_t m = 0; m < count; ++m) {
+                const float *e = glm::value_ptr(expected[m]);
+                const float *o = glm::value_ptr(out[m]);
+                float scale = 1.f;
+                for (int i = 0; i < 16; ++i) {
+                    scale = max(scale, fabsf(e[i]));
+                }
+                for (int i = 0; i < 16; ++i) {
+                    if (!(fabsf(o[i] - e[i]) <= EPSILON * scale)) {
+                        printf("FAIL %s count %zu matrix %zu element %d: %g, expected %g\n",
+                                transformIsaName(isa), count, m, i, o[i], e[i]);
+                        ++failures;
+                        break;
+                    }
+                }
+            }
+            if (glm::value_ptr(out[count])[0] != 12345.f) {
+                printf("FAIL %s count %zu: wrote past the batch\n", transformIsaName(isa), count);
+                ++failures;
+            }
+        }
+    }
+
+    // Dispatch picks one of the above
+    printf("transform: %s, %d failures\n", transformIsaName(transformIsa()), failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <iostream>
+
+#include "context.h"
+#include "glhandle.h"
+#include "stb_image.h"
+
+struct Texture {
+    TextureHandle texture;
+
+    Texture(const char *path, const GLenum format, const GLenum loadformat) {
+        this->texture = TextureHandle::create();
+        glBindTexture(GL_TEXTURE_2D, this->texture);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        int width, height, nrChannels;
+        stbi_set_flip_vertically_on_load(true);
+        unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0); 
+        if (!data) {
+            std::cout << "ERROR::TEXTURE::IMAGE_CANNOT_BE_LOADED" << std::endl;
+
+            SDL_GL_DeleteContext(cont);
+            SDL_DestroyWindow(win);
+            SDL_Quit();
+            exit(1);
+
+            stbi_image_free(data);
+        }
+
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, loadformat, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        stbi_image_free(data);
+    }
+
+    operator int() const { return texture; }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Fixed-step simulation clock. Real time accumulates and is consumed in
+// whole steps; what remains is the fraction of a step rendering is
+// ahead of the simulation, to interpolate between its last two states.
+struct FixedTimestep {
+    double step;       // Seconds
+    int maxSteps;      // Per advance(); the rest is dropped so a slow frame can't snowball
+    double accumulator;
+    double time;       // Simulated seconds
+    long long steps;
+
+    FixedTimestep(double step, int maxSteps = 8)
+        : step(step), maxSteps(maxSteps), accumulator(0.0), time(0.0), steps(0) {}
+
+    // Adds elapsed real seconds, returns how many steps to simulate now
+    int advance(double elapsed) {
+        this->accumulator += elapsed;
+        int n = (int)std::min(this->accumulator / this->step, (double)this->maxSteps);
+        this->accumulator -= n * this->step;
+
+        // Beyond maxSteps only the fraction of a step is kept
+        if (this->accumulator >= this->step) {
+            this->accumulator = std::fmod(this->accumulator, this->step);
+        }
+        this->time += n * this->step;
+        this->steps += n;
+        return n;
+    }
+
+    // Weight of the newest state, in [0, 1)
+    float alpha() const { return std::min(float(this->accumulator / this->step), std::nextafter(1.f, 0.f)); }
+};
@@ -0,0 +1,275 @@
+#include "tlsf.h"
+
+#include <algorithm>
+
+using namespace std;
+
+const uint32_t TlsfAllocator::INVALID;
+const unsigned TlsfAllocator::SL_BITS;
+const unsigned TlsfAllocator::SL_COUNT;
+const unsigned TlsfAllocator::FL_COUNT;
+
+static unsigned log2Floor(uint64_t x) {
+    return 63 - __builtin_clzll(x);
+}
+
+// Size class holding blocks of size
+static void mapping(uint64_t size, unsigned &fl, unsigned &sl) {
+    if (size < TlsfAllocator::SL_COUNT) {
+        fl = 0;
+        sl = size;
+    } else {
+        unsigned l = log2Floor(size);
+        fl = l - TlsfAllocator::SL_BITS + 1;
+        sl = (size >> (l - TlsfAllocator::SL_BITS)) ^ TlsfAllocator::SL_COUNT;
+    }
+}
+
+float TlsfAllocator::Stats::fragmentation() const {
+    uint64_t free = this->capacity - this->used;
+    return free == 0 ? 0.f : 1.f - float(this->largestFree) / float(free);
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity)
+        : flBitmap(0), lastBlock(INVALID), capacity(0), used(0), allocations(0) {
+    fill(&this->heads[0][0], &this->heads[0][0] + FL_COUNT * SL_COUNT, INVALID);
+    fill(this->slBitmap, this->slBitmap + FL_COUNT, 0u);
+    this->grow(capacity);
+}
+
+uint32_t TlsfAllocator::newBlock() {
+    if (!this->unusedBlocks.empty()) {
+        uint32_t block = this->unusedBlocks.back();
+        this->unusedBlocks.pop_back();
+        return block;
+    }
+    this->blocks.push_back(Block());
+    return this->blocks.size() - 1;
+}
+
+void TlsfAllocator::insertFree(uint32_t block) {
+    Block &b = this->blocks[block];
+    unsigned fl, sl;
+    mapping(b.size, fl, sl);
+
+    b.free = true;
+    b.prevFree = INVALID;
+    b.nextFree = this->heads[fl][sl];
+    if (b.nextFree != INVALID) {
+        this->blocks[b.nextFree].prevFree = block;
+    }
+    this->heads[fl][sl] = block;
+    this->flBitmap |= 1ull << fl;
+    this->slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t block) {
+    Block &b = this->blocks[block];
+    unsigned fl, sl;
+    mapping(b.size, fl, sl);
+
+    if (b.prevFree != INVALID) {
+        this->blocks[b.prevFree].nextFree = b.nextFree;
+    } else {
+        this->heads[fl][sl] = b.nextFree;
+    }
+    if (b.nextFree != INVALID) {
+        this->blocks[b.nextFree].prevFree = b.prevFree;
+    }
+    if (this->heads[fl][sl] == INVALID) {
+        this->slBitmap[fl] &= ~(1u << sl);
+        if (this->slBitmap[fl] == 0) {
+            this->flBitmap &= ~(1ull << fl);
+        }
+    }
+    b.free = false;
+}
+
+uint64_t TlsfAllocator::roundUp(uint64_t size) {
+    if (size < SL_COUNT) {
+        return size;
+    }
+    uint64_t step = 1ull << (log2Floor(size) - SL_BITS);
+    return size + step - 1 < size ? size : (size + step - 1) & ~(step - 1);
+}
+
+uint32_t TlsfAllocator::findFree(uint64_t size) const {
+    // Round up to the next class so any block of it fits
+    unsigned fl, sl;
+    mapping(roundUp(size), fl, sl);
+    if (fl < FL_COUNT) {
+        uint32_t slMap = this->slBitmap[fl] & (~0u << sl);
+        uint64_t flMap = fl + 1 < 64 ? this->flBitmap & (~0ull << (fl + 1)) : 0;
+        if (slMap != 0) {
+            return this->heads[fl][__builtin_ctz(slMap)];
+        }
+        if (flMap != 0) {
+            fl = __builtin_ctzll(flMap);
+            return this->heads[fl][__builtin_ctz(this->slBitmap[fl])];
+        }
+    }
+
+    // Otherwise only blocks of size's own class may still fit, a size off
+    // a class boundary included
+    mapping(size, fl, sl);
+    if (fl >= FL_COUNT) {
+        return INVALID;
+    }
+    for (uint32_t block = this->heads[fl][sl]; block != INVALID; block = this->blocks[block].nextFree) {
+        if (this->blocks[block].size >= size) {
+            return block;
+        }
+    }
+    return INVALID;
+}
+
+uint32_t TlsfAllocator::allocate(uint64_t size) {
+    size = max<uint64_t>(size, 1);
+    uint32_t block = this->findFree(size);
+    if (block == INVALID) {
+        return INVALID;
+    }
+    this->removeFree(block);
+
+    // Split off the remainder
+    if (this->blocks[block].size > size) {
+        uint32_t rest = this->newBlock();
+        Block &b = this->blocks[block];
+        Block &r = this->blocks[rest];
+        r.offset = b.offset + size;
+        r.size = b.size - size;
+        r.prevPhysical = block;
+        r.nextPhysical = b.nextPhysical;
+        if (r.nextPhysical != INVALID) {
+            this->blocks[r.nextPhysical].prevPhysical = rest;
+        } else {
+            this->lastBlock = rest;
+        }
+        b.size = size;
+        b.nextPhysical = rest;
+        this->insertFree(rest);
+    }
+
+    this->used += size;
+    ++this->allocations;
+    return block;
+}
+
+void TlsfAllocator::free(uint32_t block) {
+    this->used -= this->blocks[block].size;
+    --this->allocations;
+
+    // Merge with free neighbours
+    uint32_t next = this->blocks[block].nextPhysical;
+    if (next != INVALID && this->blocks[next].free) {
+        this->removeFree(next);
+        Block &b = this->blocks[block];
+        b.size += this->blocks[next].size;
+        b.nextPhysical = this->blocks[next].nextPhysical;
+        if (b.nextPhysical != INVALID) {
+            this->blocks[b.nextPhysical].prevPhysical = block;
+        } else {
+            this->lastBlock = block;
+        }
+        this->unusedBlocks.push_back(next);
+    }
+    uint32_t prev = this->blocks[block].prevPhysical;
+    if (prev != INVALID && this->blocks[prev].free) {
+        this->removeFree(prev);
+        Block &p = this->blocks[prev];
+        p.size += this->blocks[block].size;
+        p.nextPhysical = this->blocks[block].nextPhysical;
+        if (p.nextPhysical != INVALID) {
+            this->blocks[p.nextPhysical].prevPhysical = prev;
+        } else {
+            this->lastBlock = prev;
+        }
+        this->unusedBlocks.push_back(block);
+        block = prev;
+    }
+    this->insertFree(block);
+}
+
+void TlsfAllocator::grow(uint64_t capacity) {
+    if (capacity <= this->capacity) {
+        return;
+    }
+    uint64_t added = capacity - this->capacity;
+
+    uint32_t last = this->lastBlock;
+    if (last != INVALID && this->blocks[last].free) {
+        this->removeFree(last);
+        this->blocks[last].size += added;
+        this->insertFree(last);
+    } else {
+        uint32_t block = this->newBlock();
+        Block &b = this->blocks[block];
+        b.offset = this->capacity;
+        b.size = added;
+        b.prevPhysical = last;
+        b.nextPhysical = INVALID;
+        if (last != INVALID) {
+            this->blocks[last].nextPhysical = block;
+        }
+        this->lastBlock = block;
+        this->insertFree(block);
+    }
+    this->capacity = capacity;
+}
+
+vector<TlsfAllocator::Move> TlsfAllocator::defragment() {
+    vector<Move> moves;
+
+    // Allocated blocks in offset order
+    vector<uint32_t> live;
+    for (uint32_t block = this->lastBlock; block != INVALID; block = this->blocks[block].prevPhysical) {
+        if (!this->blocks[block].free) {
+            live.push_back(block);
+        } else {
+            this->removeFree(block);
+            this->unusedBlocks.push_back(block);
+        }
+    }
+    reverse(live.begin(), live.end());
+
+    uint64_t offset = 0;
+    uint32_t prev = INVALID;
+    for (uint32_t block : live) {
+        Block &b = this->blocks[block];
+        if (b.offset != offset) {
+            Move move = { block, b.offset, offset, b.size };
+            moves.push_back(move);
+            b.offset = offset;
+        }
+        b.prevPhysical = prev;
+        b.nextPhysical = INVALID;
+        if (prev != INVALID) {
+            this->blocks[prev].nextPhysical = block;
+        }
+        offset += b.size;
+        prev = block;
+    }
+    this->lastBlock = prev;
+
+    // Everything left over becomes one block again
+    uint64_t capacity = this->capacity;
+    this->capacity = offset;
+    this->grow(capacity);
+    return moves;
+}
+
+TlsfAllocator::Stats TlsfAllocator::stats() const {
+    Stats stats;
+    stats.capacity = this->capacity;
+    stats.used = this->used;
+    stats.largestFree = 0;
+    stats.allocations = this->allocations;
+    stats.freeBlocks = 0;
+    for (uint32_t block = this->lastBlock; block != INVALID; block = this->blocks[block].prevPhysical) {
+        if (this->blocks[block].free) {
+            stats.largestFree = max(stats.largestFree, this->blocks[block].size);
+            ++stats.freeBlocks;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit allocator of a range [0, capacity) of abstract
+// units, e.g. vertices of a GPU buffer. Only offsets are handed out, no
+// memory is touched. Free blocks are kept in lists per size class: the
+// first level by power of two, the second splitting it linearly, found
+// in constant time through bitmaps. Freed blocks merge with free
+// neighbours right away.
+struct TlsfAllocator {
+    static const uint32_t INVALID = ~0u;
+    static const unsigned SL_BITS = 4;
+    static const unsigned SL_COUNT = 1 << SL_BITS;
+    static const unsigned FL_COUNT = 64 - SL_BITS + 1;
+
+    struct Block {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t prevPhysical, nextPhysical;
+        uint32_t prevFree, nextFree;
+        bool free;
+    };
+
+    // A block moved by defragment()
+    struct Move {
+        uint32_t block;
+        uint64_t from;
+        uint64_t to;
+        uint64_t size;
+    };
+
+    struct Stats {
+        uint64_t capacity;
+        uint64_t used;
+        uint64_t largestFree;
+        size_t allocations;
+        size_t freeBlocks;
+
+        // 0 when all free space is one block, towards 1 as it splinters
+        float fragmentation() const;
+    };
+
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedBlocks;  // Recycled entries of blocks
+    uint32_t heads[FL_COUNT][SL_COUNT];
+    uint64_t flBitmap;
+    uint32_t slBitmap[FL_COUNT];
+    uint32_t lastBlock;  // Highest offset
+    uint64_t capacity;
+    uint64_t used;
+    size_t allocations;
+
+    TlsfAllocator(uint64_t capacity = 0);
+
+    // Block id of size units, INVALID when no free block is large enough
+    uint32_t allocate(uint64_t size);
+    void free(uint32_t block);
+
+    uint64_t offset(uint32_t block) const { return this->blocks[block].offset; }
+    uint64_t size(uint32_t block) const { return this->blocks[block].size; }
+
+    // Size rounded up to the next class boundary; a free block at least
+    // this large is found in constant time
+    static uint64_t roundUp(uint64_t size);
+
+    // Adds units at the end of the range
+    void grow(uint64_t capacity);
+
+    // Packs allocated blocks to the front, in offset order, leaving one
+    // free block at the end. Block ids stay valid; returns what moved.
+    std::vector<Move> defragment();
+
+    Stats stats() const;
+
+private:
+    uint32_t newBlock();
+    void insertFree(uint32_t block);
+    void removeFree(uint32_t block);
+    uint32_t findFree(uint64_t size) const;
+};
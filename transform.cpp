@@ -0,0 +1,123 @@
+#include "transform.h"
+
+#include <immintrin.h>
+
+TransformIsa transformIsa() {
+    static TransformIsa isa = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return TRANSFORM_AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return TRANSFORM_AVX2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return TRANSFORM_SSE;
+        }
+        return TRANSFORM_SCALAR;
+    }();
+    return isa;
+}
+
+const char *transformIsaName(TransformIsa isa) {
+    switch (isa) {
+        case TRANSFORM_SCALAR: return "scalar";
+        case TRANSFORM_SSE:    return "sse";
+        case TRANSFORM_AVX2:   return "avx2";
+        case TRANSFORM_AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+void mulMat4Batch(const float *a, const float *b, float *out, size_t count) {
+    switch (transformIsa()) {
+        case TRANSFORM_AVX512: mulMat4BatchAvx512(a, b, out, count); break;
+        case TRANSFORM_AVX2:   mulMat4BatchAvx2  (a, b, out, count); break;
+        case TRANSFORM_SSE:    mulMat4BatchSse   (a, b, out, count); break;
+        default:               mulMat4BatchScalar(a, b, out, count); break;
+    }
+}
+
+// Column j of the result is a * (column j of b), i.e. a linear combination
+// of columns of a. Every kernel below computes exactly that.
+
+void mulMat4BatchScalar(const float *a, const float *b, float *out, size_t count) {
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+        for (int col = 0; col < 4; ++col) {
+            for (int row = 0; row < 4; ++row) {
+                out[col * 4 + row] = a[0 * 4 + row] * b[col * 4 + 0]
+                                   + a[1 * 4 + row] * b[col * 4 + 1]
+                                   + a[2 * 4 + row] * b[col * 4 + 2]
+                                   + a[3 * 4 + row] * b[col * 4 + 3];
+            }
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+void mulMat4BatchSse(const float *a, const float *b, float *out, size_t count) {
+    __m128 a0 = _mm_loadu_ps(a + 0);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+        for (int col = 0; col < 4; ++col) {
+            __m128 v = _mm_loadu_ps(b + col * 4);
+            __m128 r =        _mm_mul_ps(a0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm_storeu_ps(out + col * 4, r);
+        }
+    }
+}
+
+// Two columns per register: both 128-bit halves hold the same column of a
+__attribute__((target("avx2,fma")))
+void mulMat4BatchAvx2(const float *a, const float *b, float *out, size_t count) {
+    __m256 a0 = _mm256_broadcast_ps((const __m128*)(a + 0));
+    __m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+    __m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+    __m256 a3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+        __m256 v01 = _mm256_loadu_ps(b + 0);
+        __m256 v23 = _mm256_loadu_ps(b + 8);
+
+        __m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(v01, 0x00));
+        __m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(v23, 0x00));
+        r01 = _mm256_fmadd_ps(a1, _mm256_permute_ps(v01, 0x55), r01);
+        r23 = _mm256_fmadd_ps(a1, _mm256_permute_ps(v23, 0x55), r23);
+        r01 = _mm256_fmadd_ps(a2, _mm256_permute_ps(v01, 0xAA), r01);
+        r23 = _mm256_fmadd_ps(a2, _mm256_permute_ps(v23, 0xAA), r23);
+        r01 = _mm256_fmadd_ps(a3, _mm256_permute_ps(v01, 0xFF), r01);
+        r23 = _mm256_fmadd_ps(a3, _mm256_permute_ps(v23, 0xFF), r23);
+
+        _mm256_storeu_ps(out + 0, r01);
+        _mm256_storeu_ps(out + 8, r23);
+    }
+}
+
+// Whole matrix per register: all four 128-bit lanes hold the same column of a.
+// Zero-masked forms with every lane set compile to the plain instructions,
+// whose GCC 12 intrinsics warn about their undefined pass-through operand.
+__attribute__((target("avx512f")))
+void mulMat4BatchAvx512(const float *a, const float *b, float *out, size_t count) {
+    const __mmask16 ALL = 0xFFFF;
+    __m512 a0 = _mm512_maskz_broadcast_f32x4(ALL, _mm_loadu_ps(a + 0));
+    __m512 a1 = _mm512_maskz_broadcast_f32x4(ALL, _mm_loadu_ps(a + 4));
+    __m512 a2 = _mm512_maskz_broadcast_f32x4(ALL, _mm_loadu_ps(a + 8));
+    __m512 a3 = _mm512_maskz_broadcast_f32x4(ALL, _mm_loadu_ps(a + 12));
+
+    for (size_t i = 0; i < count; ++i, b += 16, out += 16) {
+        __m512 v = _mm512_loadu_ps(b);
+
+        __m512 r = _mm512_mul_ps(a0, _mm512_maskz_permute_ps(ALL, v, 0x00));
+        r = _mm512_fmadd_ps(a1, _mm512_maskz_permute_ps(ALL, v, 0x55), r);
+        r = _mm512_fmadd_ps(a2, _mm512_maskz_permute_ps(ALL, v, 0xAA), r);
+        r = _mm512_fmadd_ps(a3, _mm512_maskz_permute_ps(ALL, v, 0xFF), r);
+
+        _mm512_storeu_ps(out, r);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// Batch matrix kernels. Matrices are column-major 4x4 float arrays laid out
+// back to back (the layout of glm::mat4 and of glUniformMatrix4fv), so the
+// results can be uploaded as they are.
+
+enum TransformIsa {
+    TRANSFORM_SCALAR,
+    TRANSFORM_SSE,
+    TRANSFORM_AVX2,
+    TRANSFORM_AVX512,
+};
+
+// Best instruction set supported by the running CPU
+TransformIsa transformIsa();
+const char *transformIsaName(TransformIsa isa);
+
+// out[i] = a * b[i] for i in [0, count). Out must not alias a.
+void mulMat4Batch(const float *a, const float *b, float *out, size_t count);
+
+// Fixed implementations, mainly for comparing against each other
+void mulMat4BatchScalar(const float *a, const float *b, float *out, size_t count);
+void mulMat4BatchSse(const float *a, const float *b, float *out, size_t count);
+void mulMat4BatchAvx2(const float *a, const float *b, float *out, size_t count);
+void mulMat4BatchAvx512(const float *a, const float *b, float *out, size_t count);
@@ -1,11 +1,21 @@
 #version 330 core
 
-layout (location = 0) in vec3 pos;
+#include "octahedral.glsl"
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (location = 0) in vec3 pos;    // unorm16, relative to bounds
+layout (location = 2) in mat4 mvp;
+layout (location = 6) in vec2 octNormal;  // Octahedral snorm16
+layout (location = 7) in mat4 model;
+
+uniform vec3 boundsMin;
+uniform vec3 boundsExtent;
+
+out vec3 normal;         // World space
+out vec3 worldPosition;
 
 void main() {
-    gl_Position = projection * view * model * vec4(pos, 1.0);
+    vec4 position = vec4(boundsMin + pos * boundsExtent, 1.0);
+    normal = mat3(model) * octDecode(octNormal);
+    worldPosition = vec3(model * position);
+    gl_Position = mvp * position;
 }
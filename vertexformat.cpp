@@ -0,0 +1,218 @@
+#include "vertexformat.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+unsigned short floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = ((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) {
+        // Inf & NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0) {
+        // Denormal or zero
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        // Round to nearest
+        if ((mantissa >> (shift - 1)) & 1) {
+            ++half;
+        }
+        return sign | half;
+    }
+
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    // Round to nearest; a carry into the exponent is still correct
+    if (mantissa & 0x1000) {
+        ++half;
+    }
+    return half;
+}
+
+static short floatToSnorm16(float value) {
+    value = max(-1.f, min(1.f, value));
+    return (short)lroundf(value * 32767.f);
+}
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2
+static void octEncode(const float *n, float out[2]) {
+    float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = l1 > 0.f ? n[0] / l1 : 0.f;
+    float y = l1 > 0.f ? n[1] / l1 : 0.f;
+    if (n[2] < 0.f) {
+        float fx = (1.f - fabsf(y)) * (x >= 0.f ? 1.f : -1.f);
+        float fy = (1.f - fabsf(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = fx;
+        y = fy;
+    }
+    out[0] = x;
+    out[1] = y;
+}
+
+VertexFormat::VertexFormat() : stride(0) {
+    for (int k = 0; k < 3; ++k) {
+        this->boundsMin[k] = 0.f;
+        this->boundsExtent[k] = 1.f;
+    }
+}
+
+VertexFormat &VertexFormat::add(GLuint location, unsigned components, AttributeEncoding encoding) {
+    VertexAttribute a = {};
+    a.location = location;
+    a.components = components;
+    a.encoding = encoding;
+    a.offset = this->stride;
+
+    switch (encoding) {
+        case ATTRIBUTE_FLOAT:
+            a.size = components;
+            a.type = GL_FLOAT;
+            a.normalized = GL_FALSE;
+            a.bytes = components * 4;
+            break;
+        case ATTRIBUTE_UNORM16:
+            a.size = components;
+            a.type = GL_UNSIGNED_SHORT;
+            a.normalized = GL_TRUE;
+            a.bytes = (components * 2 + 3) & ~3u;
+            break;
+        case ATTRIBUTE_HALF:
+            a.size = components;
+            a.type = GL_HALF_FLOAT;
+            a.normalized = GL_FALSE;
+            a.bytes = (components * 2 + 3) & ~3u;
+            break;
+        case ATTRIBUTE_OCT_SNORM16:
+            a.size = 2;
+            a.type = GL_SHORT;
+            a.normalized = GL_TRUE;
+            a.bytes = 4;
+            break;
+        default:
+            cerr << "ERROR::VERTEX_FORMAT::UNKNOWN_ENCODING " << encoding << endl;
+            return *this;
+    }
+
+    this->stride += a.bytes;
+    this->attributes.push_back(a);
+    return *this;
+}
+
+unsigned VertexFormat::sourceStride() const {
+    unsigned n = 0;
+    for (const auto &a : this->attributes) {
+        n += a.components;
+    }
+    return n;
+}
+
+vector<unsigned char> VertexFormat::encode(const Mesh &mesh) {
+    size_t count = mesh.vertexCount();
+
+    // Position bounds
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t v = 0; v < count; ++v) {
+        const float *p = mesh.position(v);
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = min(lo[k], p[k]);
+            hi[k] = max(hi[k], p[k]);
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        this->boundsMin[k] = count ? lo[k] : 0.f;
+        this->boundsExtent[k] = count && hi[k] > lo[k] ? hi[k] - lo[k] : 1.f;
+    }
+
+    vector<unsigned char> out(count * this->stride, 0);
+    for (size_t v = 0; v < count; ++v) {
+        const float *src = &mesh.vertices[v * mesh.stride];
+        unsigned char *dst = &out[v * this->stride];
+
+        for (const auto &a : this->attributes) {
+            unsigned char *p = dst + a.offset;
+            switch (a.encoding) {
+                case ATTRIBUTE_FLOAT:
+                    memcpy(p, src, a.components * sizeof(float));
+                    break;
+                case ATTRIBUTE_UNORM16:
+                    for (unsigned k = 0; k < a.components; ++k) {
+                        float t = k < 3 ? (src[k] - this->boundsMin[k]) / this->boundsExtent[k] : src[k];
+                        unsigned short q = (unsigned short)lroundf(max(0.f, min(1.f, t)) * 65535.f);
+                        memcpy(p + k * 2, &q, 2);
+                    }
+                    break;
+                case ATTRIBUTE_HALF:
+                    for (unsigned k = 0; k < a.components; ++k) {
+                        unsigned short h = floatToHalf(src[k]);
+                        memcpy(p + k * 2, &h, 2);
+                    }
+                    break;
+                case ATTRIBUTE_OCT_SNORM16: {
+                    float oct[2];
+                    octEncode(src, oct);
+                    short q[2] = { floatToSnorm16(oct[0]), floatToSnorm16(oct[1]) };
+                    memcpy(p, q, 4);
+                    break;
+                }
+            }
+            src += a.components;
+        }
+    }
+    return out;
+}
+
+void VertexFormat::decodePositions(const unsigned char *vertices, size_t count, float *out) const {
+    const VertexAttribute *position = NULL;
+    for (const auto &a : this->attributes) {
+        if (a.location == 0) {
+            position = &a;
+        }
+    }
+    if (!position) {
+        return;
+    }
+
+    for (size_t v = 0; v < count; ++v) {
+        const unsigned char *p = vertices + v * this->stride + position->offset;
+        for (int k = 0; k < 3; ++k) {
+            if (position->encoding == ATTRIBUTE_UNORM16) {
+                unsigned short q;
+                memcpy(&q, p + k * 2, 2);
+                out[v * 3 + k] = this->boundsMin[k] + q / 65535.f * this->boundsExtent[k];
+            } else {
+                memcpy(&out[v * 3 + k], p + k * 4, 4);
+            }
+        }
+    }
+}
+
+void VertexFormat::apply(GLintptr offset) const {
+    for (const auto &a : this->attributes) {
+        glVertexAttribPointer(a.location, a.size, a.type, a.normalized, this->stride, (void*)(offset + a.offset));
+        glEnableVertexAttribArray(a.location);
+    }
+}
+
+void VertexFormat::setUniforms(ShaderProgram &program) const {
+    program.set3f("boundsMin", this->boundsMin[0], this->boundsMin[1], this->boundsMin[2]);
+    program.set3f("boundsExtent", this->boundsExtent[0], this->boundsExtent[1], this->boundsExtent[2]);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+
+#include "context.h"
+#include "mesh.h"
+#include "shader.h"
+
+enum AttributeEncoding {
+    ATTRIBUTE_FLOAT,         // As is
+    ATTRIBUTE_UNORM16,       // Positions: 16 bits per component relative to mesh bounds
+    ATTRIBUTE_HALF,          // Texture coordinates: half floats
+    ATTRIBUTE_OCT_SNORM16,   // Normals: octahedral mapping to 2 x 16 bit snorm
+};
+
+struct VertexAttribute {
+    GLuint location;
+    unsigned components;  // Floats in the source vertex
+    AttributeEncoding encoding;
+
+    // Resulting glVertexAttribPointer layout
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    unsigned offset;  // Bytes
+    unsigned bytes;
+};
+
+// Packed GPU vertex layout built from float attributes of a Mesh,
+// in the order they are stored there. Quantized positions are restored
+// in the vertex shader by boundsMin + pos * boundsExtent.
+struct VertexFormat {
+    std::vector<VertexAttribute> attributes;
+    unsigned stride;  // Bytes, kept a multiple of 4
+
+    float boundsMin[3];
+    float boundsExtent[3];
+
+    VertexFormat();
+
+    VertexFormat &add(GLuint location, unsigned components, AttributeEncoding encoding);
+
+    // Floats per source vertex
+    unsigned sourceStride() const;
+
+    // Packs mesh vertices; also computes position bounds for UNORM16
+    std::vector<unsigned char> encode(const Mesh &mesh);
+
+    // Restores float positions (attribute location 0) of packed vertices,
+    // 3 floats per vertex
+    void decodePositions(const unsigned char *vertices, size_t count, float *out) const;
+
+    // Sets attribute pointers for the currently bound VAO & array buffer
+    void apply(GLintptr offset = 0) const;
+
+    void setUniforms(ShaderProgram &program) const;
+};
+
+unsigned short floatToHalf(float value);